@@ -455,128 +455,6 @@
         return $OK
     }
 
-    ############################################################################
-    # Expand a triplet built with prefix, lower and upper numerical bounds     #
-    # Args:                                                                    #
-    #       -$1: prefix                                                        #
-    #       -$2: lower integer bound, potentially with leading zeros           #
-    #       -$3: upper integer bound, potentially with leading zeros           #
-    #       -$4: suffix                                                        #
-    #                                                                          #
-    # Result: a space separated list of enumerated values                      #
-    # or $EINVNUM if some argument are missing                                 #
-    # or $EINVOPT if lower or upper bounds are not integer are missing         #
-    expand_element()
-    {
-        # Check number of input arguments
-        if [[ "$#" -lt 3 ]]; then
-            print_error $EINVNUM; return $?
-        fi
-        local prefix=$1
-        local lower=$2;
-        local upper=$3;
-        local suffix=$4;
-        is_numeric $lower
-        if [[ $? != 0   ]]; then
-             print_error $EINVOPT; return $?
-        fi
-        is_numeric $upper
-        if [[ $? != 0 ]]; then
-            print_error $EINVOPT; return $?
-        fi
-
-        # seq -w manage width and takes care of leading zero
-        for i in $(seq -w $lower $upper) ; do
-        printf "%s%s," $prefix$i$suffix
-        done
-    }
-
-    ############################################################################
-    # Format the strings provided as argument to node_set                      #
-    # The difficulty to solve is related to comma                              #
-    # which can be used within pattern or as token separator                   #
-    # e.g.:                                                                    #
-    # imenode[1],ime_head_0 imeserver{1,5,7}                                   #
-    #           ^_ we want to remove this comma                                #
-    # is equivalent to                                                         #
-    # imenode[1] ime_head_0 imeserver{1,5,7}                                   #
-    # Args:                                                                    #
-    #       -$1: string containing comma as token separator                    #
-    # Result: string where commas are only used within patterns                #
-    preprocess_node_set()
-    {
-        local string=$1
-        local cleaned=""
-        local TRIGGER=1
-        for (( i=0; i<${#string}; i++ )); do
-            char=${string:$i:1};
-            if [[ $char =~ [\{\[] ]]; then TRIGGER=0; fi
-            if [[ $char =~ [\]\}] ]]; then TRIGGER=1; fi
-            # if trigger is on, the replace comma by space
-            [[ $TRIGGER  != 0 ]] &&  char=${char/,/ }
-            cleaned+="$char"
-        done
-        printf "$cleaned"
-    }
-
-############################################################################
-# Expand a list potentially complex of patterns.                           #
-# 3 kinds of formats are supported:                                        #
-# [-] to indicate a numerical sequence that need to be expanded            #
-# [,] to indicate a numerical sequence to add to a prefix                  #
-# {,} to indicate a numerical sequence to add to a prefix (equ. to above)  #
-#                                                                          #
-# eg. node[02-6,9-10, 15-17]                                               #
-# will return:                                                             #
-# node02,node03,node04,node05,node06,node09,node10,node15,node16,node17    #
-# Args:                                                                    #
-#       -$1: string describing a list of node potentially using patterns   #
-#       -$2: suffix to append to each node entry of the list               #
-# Result: a comma separated list of expanded values                        #
-node_set()
-{
-        local string=$1
-        local suffix=$2
-        local result=""
-
-        string=$(preprocess_node_set "$string")
-        for word in ${string[*]}; do
-            # comma separated list value {,}
-            if [[  "$word" =~ "{"  ]] ; then
-                local prefix=`echo $word | cut -d'{' -f1`
-                local list=`echo $word | cut -d'{' -f2`
-                list=`echo $list | tr -d "}"`
-                local sequence=(${list//,/ })
-                for element in ${sequence[*]}; do
-                result+="$prefix$element$suffix,"
-                done
-            fi
-            # range value []
-            if [[  "$word" =~ "["  ]] ; then
-                local prefix=`echo $word | cut -d'[' -f1`
-                local pattern=`echo $word | cut -d'[' -f2`
-                pattern=`echo $pattern | tr -d "]"`
-                # create the vector of sequence: replace ',' by ' '
-                local sequence=(${pattern//,/ })
-
-                for element in ${sequence[*]}; do
-                    if [[ "$element" =~ "-" ]]; then
-                        bounds=(${element//-/ })
-                        result+=$(expand_element $prefix ${bounds[0]} \
-                              ${bounds[1]} $suffix)
-                    else
-                    result+="$prefix$element$suffix,"
-                    fi
-                done
-            fi
-            # simple word
-            if [[ ! "$word" =~ "{"  && ! "$word" =~ "[" ]] ; then
-            result+="$word$suffix,"
-            fi
-        done
-        # remove trailing comma if any
-        printf "${result%,}"
-    }
     ############################################################################
     # Check return code and exit if it is not equal to 0.                      #
     # Args:                                                                    #
@@ -10,18 +10,25 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stddef.h>
-#include <string.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <libgen.h>
 #include <assert.h>
 #include <string.h>
-
-/* Number of RDMA buffers allowed to run in parallel */
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/* Default number of RDMA buffers allowed to run in parallel on a server */
 #define NUM_RDMA_BUFFERS 128
 #define NITERS (128)
 #define NFLIGHT 12
 #define MPI_ROOT_RANK 0
-#define HOST_MAX_SIZE 16 /* Keep it short */
 #define MPI_RANK_ANY -1
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
@@ -38,6 +45,9 @@ enum direction
     DIR_NONE = 0,
     DIR_PUT  = 1 << 0,
     DIR_GET  = 1 << 1,
+    DIR_SEND = 1 << 2,
+    DIR_RECV = 1 << 3,
+    DIR_BIDI = DIR_SEND | DIR_RECV,
 };
 
 const char * direction_str[] =
@@ -45,6 +55,9 @@ const char * direction_str[] =
     [DIR_NONE] = "Und",
     [DIR_PUT]  = "Put",
     [DIR_GET]  = "Get",
+    [DIR_SEND] = "Snd",
+    [DIR_RECV] = "Rcv",
+    [DIR_BIDI] = "Bid",
 };
 
 #define MPI_CHECK(func)                                                        \
@@ -54,16 +67,104 @@ do {                                                                           \
     if (rc) MPI_Abort(MPI_COMM_WORLD, rc);                                     \
 } while(0)
 
-enum operation
+/* Communication patterns of the all-to-all mode */
+enum pattern
+{
+    PATTERN_LINKTEST = 0, /* Pairs of ranks, every link once */
+    PATTERN_SHIFT,        /* Send to rank + i, receive from rank - i */
+    PATTERN_RANDOM,       /* Random cyclic permutation at every step */
+    PATTERN_BISECTION,    /* First half of the ranks sends to the other one */
+    PATTERN_INCAST,       /* N-to-1: every rank receives from all the others */
+    PATTERN_BROADCAST,    /* 1-to-N: every rank sends to all the others */
+    PATTERN_NEIGHBOR,     /* Nearest neighbors on a ring */
+    _PATTERN_LAST,
+};
+
+const char * pattern_str[] =
+{
+    [PATTERN_LINKTEST]  = "linktest",
+    [PATTERN_SHIFT]     = "shift",
+    [PATTERN_RANDOM]    = "random",
+    [PATTERN_BISECTION] = "bisection",
+    [PATTERN_INCAST]    = "incast",
+    [PATTERN_BROADCAST] = "broadcast",
+    [PATTERN_NEIGHBOR]  = "neighbor",
+};
+
+/* Handling of the links between two ranks of the same node */
+enum intra_mode
+{
+    INTRA_INCLUDE = 0, /* Test them as any other link */
+    INTRA_SKIP,        /* Do not test them */
+    INTRA_SEPARATE,    /* Test them, but report them in a separate table */
+    _INTRA_LAST,
+};
+
+const char * intra_mode_str[] =
+{
+    [INTRA_INCLUDE]  = "include",
+    [INTRA_SKIP]     = "skip",
+    [INTRA_SEPARATE] = "separate",
+};
+
+/* Memory of the data buffers */
+enum buffer_kind
+{
+    BUFFER_MALLOC = 0,
+    BUFFER_HUGE_2M,
+    BUFFER_HUGE_1G,
+    BUFFER_MPI,
+    _BUFFER_LAST,
+};
+
+const char * buffer_kind_str[] =
+{
+    [BUFFER_MALLOC]  = "malloc",
+    [BUFFER_HUGE_2M] = "huge2m",
+    [BUFFER_HUGE_1G] = "huge1g",
+    [BUFFER_MPI]     = "mpi",
+};
+
+/* Optional text export of the link-bandwidth matrix */
+enum matrix_export
+{
+    MATRIX_EXPORT_NONE = 0,
+    MATRIX_EXPORT_CSV,
+    MATRIX_EXPORT_JSON,
+    _MATRIX_EXPORT_LAST,
+};
+
+const char * matrix_export_str[] =
+{
+    [MATRIX_EXPORT_NONE] = "none",
+    [MATRIX_EXPORT_CSV]  = "csv",
+    [MATRIX_EXPORT_JSON] = "json",
+};
+
+enum results_format
+{
+    RESULTS_FORMAT_JSON = 0, /* JSON lines */
+    RESULTS_FORMAT_CSV,
+    _RESULTS_FORMAT_LAST,
+};
+
+const char * results_format_str[] =
+{
+    [RESULTS_FORMAT_JSON] = "json",
+    [RESULTS_FORMAT_CSV]  = "csv",
+};
+
+enum link_class
 {
-    OP_SUM = 0,
-    OP_MIN,
-    OP_MAX,
-    _OP_LAST,
+    LINK_INTER = 0, /* Ranks on different nodes */
+    LINK_INTRA,     /* Ranks on the same node */
+    _LINK_LAST,
 };
 
-MPI_Datatype results_dtype;
-MPI_Op       results_op[_OP_LAST];
+MPI_Datatype reduced_dtype;
+MPI_Op       reduced_op;
+MPI_Datatype hist_dtype;
+MPI_Op       hist_op;
 MPI_Comm     clients_comm = MPI_COMM_NULL;
 
 struct globals
@@ -73,15 +174,108 @@ struct globals
     int niters;
     int nflight;
     int nservers;
-    int bsize;
+    size_t *sizes; /* Message sizes of the sweep, in bytes */
+    int nsizes;
     int nclients;
     bool hostname_resolve;
     bool sequential_ios;
-    char hostname[HOST_MAX_SIZE];
-    char *hosts;
+    int concurrent;       /* Pairs at once in sequential mode */
+    bool bidirectional;
+    enum pattern pattern;
+    unsigned int seed;
+    int fanout;
+    enum intra_mode intra_mode;
+    int nnodes;
+    int *node_ids; /* Node index of every rank */
+    const char *matrix_prefix;
+    enum matrix_export matrix_export;
+    bool analyze;
+    double time_per_size; /* Seconds, 0 to run a fixed number of iters */
+    double duration;      /* Seconds for the whole sweep */
+    double ci_target;     /* Percents of the bandwidth */
+    bool persistent;      /* Persistent requests in the hot loops */
+    bool alltoall_rma;    /* One-sided flavor of the all-to-all sizes */
+    enum buffer_kind buffer_kind;
+    const char *numa;     /* NUMA binding requested: none, auto or a node */
+    int numa_node;        /* NUMA node of the buffers, -1 for none */
+    bool verify;          /* Check the payload of the messages */
+    uint64_t verified;    /* Messages checked, over the run */
+    uint64_t corrupted;   /* Corrupted messages, over the run */
+    double monitor;       /* Seconds of monitoring mode, 0 for a sweep */
+    double interval;      /* Seconds between two monitoring reports */
+    const char *series_path; /* Per-link time series of the monitoring */
+    bool clock_sync;      /* Global clock for one-way timings */
+    bool pairs;           /* Per (client, server) table */
+    double triage;        /* Percents of the median bw of a healthy flow */
+    bool calibrate;       /* Measure the overheads of the tool first */
+    const char *results_path; /* Machine-readable results */
+    enum results_format results_format;
+    const char *baseline_path; /* Results of a previous run to compare to */
+    double tolerance;     /* Percents of regression before failing */
+    const char *expand;   /* Hostlist to print expanded, without MPI */
+    const char *expand_file; /* Host file to print expanded, without MPI */
+    bool batch_mode;
+    int server_slots;
+    bool server_blocking;
+    char **nodes;         /* Name of every node, indexed by node_ids */
+    char **hosts;         /* '<node>-<rank>' of every rank, the rank of a
+                           * server or the one of a client in clients_comm */
     enum output_mode output_mode;
 };
-#define GLOBALS_INIT { -1, -1, NITERS, NFLIGHT, 0, -1, 0, false, false, {0}, NULL, OUTPUT_MPI}
+#define GLOBALS_INIT                                                           \
+{                                                                              \
+    .glob_rank        = -1,                                                    \
+    .glob_size        = -1,                                                    \
+    .niters           = NITERS,                                                \
+    .nflight          = NFLIGHT,                                               \
+    .nservers         = 0,                                                     \
+    .sizes            = NULL,                                                  \
+    .nsizes           = 0,                                                     \
+    .nclients         = 0,                                                     \
+    .hostname_resolve = false,                                                 \
+    .sequential_ios   = false,                                                 \
+    .concurrent       = 1,                                                     \
+    .bidirectional    = false,                                                 \
+    .pattern          = PATTERN_LINKTEST,                                      \
+    .seed             = 0,                                                     \
+    .fanout           = 1,                                                     \
+    .intra_mode       = INTRA_INCLUDE,                                         \
+    .nnodes           = 0,                                                     \
+    .node_ids         = NULL,                                                  \
+    .matrix_prefix    = NULL,                                                  \
+    .matrix_export    = MATRIX_EXPORT_NONE,                                    \
+    .analyze          = false,                                                 \
+    .time_per_size    = 0,                                                     \
+    .duration         = 0,                                                     \
+    .ci_target        = 1.0,                                                   \
+    .persistent       = false,                                                 \
+    .alltoall_rma     = false,                                                 \
+    .buffer_kind      = BUFFER_MALLOC,                                         \
+    .numa             = "none",                                                \
+    .numa_node        = -1,                                                    \
+    .verify           = false,                                                 \
+    .verified         = 0,                                                     \
+    .corrupted        = 0,                                                     \
+    .monitor          = 0,                                                     \
+    .interval         = 60,                                                    \
+    .series_path      = NULL,                                                  \
+    .clock_sync       = false,                                                 \
+    .pairs            = false,                                                 \
+    .triage           = 0,                                                     \
+    .calibrate        = false,                                                 \
+    .results_path     = NULL,                                                  \
+    .results_format   = RESULTS_FORMAT_JSON,                                   \
+    .baseline_path    = NULL,                                                  \
+    .tolerance        = 10,                                                    \
+    .expand           = NULL,                                                  \
+    .expand_file      = NULL,                                                  \
+    .batch_mode       = false,                                                 \
+    .server_slots     = NUM_RDMA_BUFFERS,                                      \
+    .server_blocking  = false,                                                 \
+    .nodes            = NULL,                                                  \
+    .hosts            = NULL,                                                  \
+    .output_mode      = OUTPUT_MPI,                                            \
+}
 static struct globals my = GLOBALS_INIT;
 
 struct results
@@ -92,6 +286,40 @@ struct results
     double exec_time;
 };
 
+/* SUM, MIN and MAX of the results of all the ranks, reduced at once. MIN
+ * and MAX only cover the ranks which have results */
+struct results_reduced
+{
+    struct results sum;
+    struct results min;
+    struct results max;
+    double count;       /* Ranks with results */
+};
+
+/* Time spent by a rank in each direction */
+struct step_times
+{
+    double tx;  /* Until all the sends completed */
+    double rx;  /* Until all the receives completed */
+    double all; /* Until all the messages (data and responses) completed */
+};
+
+/* Latency histogram, in nanoseconds. Values below HIST_SUB_COUNT get their
+ * own bucket, then every power of two is split into HIST_SUB_COUNT linear
+ * sub-buckets, which bounds the relative error to 1 / HIST_SUB_COUNT. It has
+ * a fixed size so that recording a sample never allocates memory. */
+#define HIST_SUB_BITS  3
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP   40 /* 2^41 ns, about 36 minutes */
+#define HIST_NBUCKETS  ((HIST_MAX_EXP - HIST_SUB_BITS + 2) * HIST_SUB_COUNT)
+
+struct histogram
+{
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HIST_NBUCKETS];
+};
+
 enum test_mode
 {
     TEST_MODE_CLIENT_SERVER,
@@ -104,17 +332,44 @@ enum peer_role
     PEER_SEND, /* current rank expects to send data to peer */
 };
 
+/* Unused entries of a step have their rank set to MPI_PROC_NULL */
 struct peer_entry
 {
     int rank;
     enum peer_role role;
 };
 
+/* Scratch space used to run an all-to-all step. It is sized for the widest
+ * step of the pattern, so that nothing gets allocated while testing */
+struct step_scratch
+{
+    MPI_Request *reqs;
+    MPI_Request *persistent;  /* Data messages per (entry, slot), responses */
+    int *indices;
+    int *owners;              /* Peer entry of each request */
+    int *slots;               /* Window slot of each data message */
+    enum peer_role *roles;    /* Direction of each data message */
+    double *stamps;           /* Post time of each data message */
+    char *responses;          /* 1-byte response of each peer entry */
+    struct step_times *times; /* Times of each peer entry */
+};
+
+/* Data received from every client and time spent receiving it, over the
+ * steps of the pattern, which make the bandwidth of the matrix */
+struct pair_flows
+{
+    double *mb;
+    double *time;
+    double *step_time; /* Slowest flow of every client in the current step */
+};
+
 struct test_config
 {
     enum test_mode test_mode;
     int curr_iter;
-    int data_size;
+    size_t data_size;
+    MPI_Datatype data_type;        /* 'data_count' of them make a message */
+    int data_count;
     int niters;
     int nflight;
     enum direction direction;
@@ -122,9 +377,21 @@ struct test_config
     void *r_buffer;
     /* All to all specific data */
     struct peer_entry *peers_list; /* List of peers to communicate with */
+    int nsteps;                    /* Number of steps of the pattern */
+    int step_width;                /* Number of peer entries per step */
+    size_t recv_regions;           /* Receive (and window) regions */
+    struct step_scratch *scratch;
+    float *pair_bw;                /* Bandwidth to every client (MB/s) */
+    struct pair_flows *flows;      /* What the bandwidth is made of */
+    /* Latency of every single operation, one histogram per link class */
+    struct histogram *hist;
     /* Client server specific data */
     void *rdma_buffer;
     MPI_Win rdma_win;
+    size_t slot_size;              /* Window region of each client slot */
+    struct pair_stats *pairs;      /* Per server (client) or client (server) */
+    struct verify_stats *verify;   /* NULL unless --verify */
+    struct one_way_stats *one_way; /* NULL unless --clock-sync */
 };
 
 /* State machine for client/server mode */
@@ -148,7 +415,7 @@ const char * rstate_str[] =
     "Dir size(B)"
 
 #define CONFIG_PRINT_FMT                                                       \
-    "%3s %7d"
+    "%3s %7zu"
 
 #define CONFIG_PRINT_ARGS(config)                                              \
     direction_str[(config)->direction],                                        \
@@ -166,6 +433,80 @@ const char * rstate_str[] =
     (res)->latency,                                                            \
     (res)->iops
 
+#define HIST_PRINT_HEADER                                                      \
+    "  p50(us)   p90(us)   p99(us) p99.9(us)   max(us)"
+
+#define HIST_PRINT_FMT                                                         \
+    "%9.2f %9.2f %9.2f %9.2f %9.2f"
+
+#define HIST_PRINT_ARGS(hist)                                                  \
+    hist_percentile(hist, 0.50),                                               \
+    hist_percentile(hist, 0.90),                                               \
+    hist_percentile(hist, 0.99),                                               \
+    hist_percentile(hist, 0.999),                                              \
+    (double) (hist)->max / 1e3
+
+static inline int hist_bucket(const uint64_t value)
+{
+    if (value < HIST_SUB_COUNT)
+        return (int) value;
+
+    const int exp = 63 - __builtin_clzll(value);
+
+    /* Values beyond 2^(HIST_MAX_EXP + 1) all land in the last bucket */
+    if (exp > HIST_MAX_EXP)
+        return HIST_NBUCKETS - 1;
+
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB_COUNT +
+           (int) ((value >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+/* Highest value (in ns) stored in a bucket */
+static uint64_t hist_bucket_max(const int bucket)
+{
+    if (bucket < HIST_SUB_COUNT)
+        return bucket;
+
+    const int exp = bucket / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+    const uint64_t sub = bucket % HIST_SUB_COUNT;
+
+    return ((HIST_SUB_COUNT + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+static inline void hist_record(struct histogram *hist, const double seconds)
+{
+    const uint64_t value = seconds > 0 ? (uint64_t) (seconds * 1e9) : 0;
+
+    hist->count++;
+    hist->max = MAX(hist->max, value);
+    hist->buckets[hist_bucket(value)]++;
+}
+
+static void hist_reset(struct histogram *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+/* Return the given quantile of the histogram, in microseconds */
+static double hist_percentile(const struct histogram *hist,
+                              const double quantile)
+{
+    const uint64_t rank = (uint64_t) (quantile * hist->count + 0.5);
+    uint64_t cumul = 0;
+
+    if (hist->count == 0)
+        return 0;
+
+    for (int i = 0; i < HIST_NBUCKETS; i++)
+    {
+        cumul += hist->buckets[i];
+        if (cumul >= MAX(rank, 1))
+            return (double) MIN(hist_bucket_max(i), hist->max) / 1e3;
+    }
+
+    return (double) hist->max / 1e3;
+}
+
 static const char *get_hostname(int rank, bool is_client)
 {
     static const char * rank_any = "all";
@@ -174,8 +515,7 @@ static const char *get_hostname(int rank, bool is_client)
     if (rank == MPI_RANK_ANY)
         return rank_any;
 
-    return (my.hosts +
-            (rank + (is_client ? my.nservers : 0)) * HOST_MAX_SIZE);
+    return my.hosts[rank + (is_client ? my.nservers : 0)];
 }
 
 bool is_server(void)
@@ -183,20 +523,69 @@ bool is_server(void)
     return clients_comm == MPI_COMM_NULL;
 }
 
+/* Intra-node links are only told apart when they are reported separately */
+static inline enum link_class get_link_class(int rank)
+{
+    if (my.intra_mode != INTRA_SEPARATE)
+        return LINK_INTER;
+
+    return my.node_ids[rank] == my.node_ids[my.glob_rank] ?
+           LINK_INTRA : LINK_INTER;
+}
+
 static void generate_results(const struct test_config *config,
                              int npeers,
                              double exec_time,
                              struct results *res)
 {
     const int niters    = config->niters;
-    const int data_size = config->data_size;
+    const size_t data_size = config->data_size;
+
+    /* Nothing was measured, e.g. no intra-node peer. Empty results are
+     * ignored by the MIN/MAX reductions */
+    if (npeers == 0 || exec_time <= 0)
+    {
+        memset(res, 0, sizeof(*res));
+        return;
+    }
 
     res->bw = (double) data_size * npeers * niters /(1024 * 1024 * exec_time);
-    res->latency = (double) exec_time / (npeers * niters * 10e-6);
+    res->latency = (double) exec_time / (npeers * niters * 1e-6);
     res->iops = (double) npeers * niters / exec_time;
     res->exec_time = exec_time;
 }
 
+/* In bidirectional mode, every exchange is reported three times: the send
+ * direction, the receive direction and the aggregate of both. 'row' gets the
+ * direction of the report, which is then used to print it */
+static const enum direction bidi_rows[] = { DIR_SEND, DIR_RECV, DIR_BIDI };
+
+static void generate_results_bidi(const struct test_config *config,
+                                  int npeers,
+                                  const struct step_times *times,
+                                  const enum direction direction,
+                                  struct test_config *row,
+                                  struct results *res)
+{
+    *row = *config;
+    row->direction = direction;
+
+    switch (direction)
+    {
+    case DIR_SEND:
+        generate_results(row, npeers, times->tx, res);
+        break;
+    case DIR_RECV:
+        generate_results(row, npeers, times->rx, res);
+        break;
+    case DIR_BIDI:
+        generate_results(row, npeers * 2, MAX(times->tx, times->rx), res);
+        break;
+    default:
+        assert(0);
+    }
+}
+
 static void print_header_verbose(const struct test_config *config)
 {
     int client_rank;
@@ -251,808 +640,6781 @@ static void *mallocz(const size_t size)
     return p;
 }
 
-static void* allocate_buffer(const size_t size)
+/* Data buffers: where and how their memory is allocated */
+#define MAX_BUFFERS 16
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+#define NUMA_MAX_NODES 1024
+
+/* Live buffers, to release each one the way it was allocated */
+static struct buffer_entry
 {
-    void *ptr =  mallocz(size);
-    assert(ptr);
-    return ptr;
-}
+    void *ptr;
+    size_t size;
+    enum buffer_kind kind;
+} buffers[MAX_BUFFERS];
 
-static void destroy_buffer(void *ptr)
+static size_t buffer_page_size(enum buffer_kind kind)
 {
-    free(ptr);
+    switch (kind)
+    {
+    case BUFFER_HUGE_2M:
+        return (size_t) 2 << 20;
+    case BUFFER_HUGE_1G:
+        return (size_t) 1 << 30;
+    default:
+        return sysconf(_SC_PAGESIZE);
+    }
 }
 
-static double client(const struct test_config *config)
+/* Bind the pages of a buffer to the NUMA node of the HCA, if requested. The
+ * range is shrunk to whole pages */
+static void bind_buffer(void *ptr, size_t size)
 {
-    double start, end;
-    int npeers = my.nservers;
-    double exec_time;
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = ((uintptr_t) ptr + page - 1) & ~(page - 1);
+    const uintptr_t end = ((uintptr_t) ptr + size) & ~(page - 1);
+    unsigned long nodemask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
 
-    const int nflight   = config->nflight;
-    const int niters    = config->niters;
-    char *s_buffer      = config->s_buffer;
-    char *r_buffer      = config->r_buffer;
+    if (my.numa_node < 0 || end <= start)
+        return;
 
-    MPI_Request reqs[nflight * 2];
-    int k = 0;
+    memset(nodemask, 0, sizeof(nodemask));
+    nodemask[my.numa_node / (8 * sizeof(unsigned long))] |=
+        1UL << (my.numa_node % (8 * sizeof(unsigned long)));
 
-    if (my.output_mode == OUTPUT_VERBOSE)
-        print_header_verbose(config);
+    if (syscall(SYS_mbind, start, end - start, MPOL_BIND, nodemask,
+                NUMA_MAX_NODES + 1, MPOL_MF_MOVE) != 0)
+        fprintf(stderr, "%d: cannot bind a buffer to NUMA node %d: %s\n",
+                my.glob_rank, my.numa_node, strerror(errno));
+}
 
-    MPI_CHECK(MPI_Barrier(clients_comm));
+/* Fault the pages in from the current rank, which is pinned by the MPI
+ * launcher, so that the first touch happens on the right node and out of
+ * the timed loops. The contents do not matter, the tests write the
+ * payloads they check, so only one byte per page is written */
+static void touch_buffer(void *ptr, size_t size, size_t page)
+{
+    volatile char *p = ptr;
 
-    start = MPI_Wtime();
+    for (size_t off = 0; off < size; off += page)
+        p[off] = 0;
+}
 
-    for (int j = 0; j < niters; j++)
-    {
-        for (int peer = 0; peer < npeers; peer++)
-        {
-            MPI_CHECK(MPI_Irecv(&r_buffer[k], 1,
-                                MPI_CHAR, peer,
-                                0,
-                                MPI_COMM_WORLD,
-                                &reqs[k * 2]));
-
-            /* Send the RDMA request. The displacement to use is encoded
-             * into the MPI TAG */
-            MPI_CHECK(MPI_Isend(&s_buffer[k], 1,
-                                MPI_CHAR, peer,
-                                k, /* MPI TAG = displacement */
-                                MPI_COMM_WORLD,
-                                &reqs[k * 2 + 1]));
-
-            /* Nflight reached, now wait for all reqs to complete */
-            if (++k >= nflight)
-            {
-                /* Wait for all Isend/Irecv to complete */
-                MPI_CHECK(MPI_Waitall(k * 2, reqs, MPI_STATUSES_IGNORE));
-                k = 0;
-            }
-        }
-    }
+static void *allocate_huge(size_t *size, enum buffer_kind kind)
+{
+    const size_t page = buffer_page_size(kind);
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                      (kind == BUFFER_HUGE_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+    static bool warned = false;
+    void *ptr;
+
+    *size = (*size + page - 1) & ~(page - 1);
+    ptr = mmap(NULL, *size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr != MAP_FAILED)
+        return ptr;
+
+    /* No reserved hugepage of that size: fall back to transparent
+     * hugepages */
+    if (!warned && my.glob_rank == MPI_ROOT_RANK)
+        fprintf(stderr, "Cannot allocate %s hugepages (%s), falling back "
+                        "to transparent hugepages\n",
+                buffer_kind_str[kind], strerror(errno));
+    warned = true;
+
+    ptr = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+    madvise(ptr, *size, MADV_HUGEPAGE);
+    return ptr;
+}
 
-    MPI_CHECK(MPI_Waitall(k * 2, reqs, MPI_STATUSES_IGNORE));
+static void* allocate_buffer(size_t size)
+{
+    const enum buffer_kind kind = my.buffer_kind;
+    struct buffer_entry *entry = NULL;
+    void *ptr = NULL;
 
-    end = MPI_Wtime();
-    exec_time = (end - start);
+    for (int i = 0; i < MAX_BUFFERS && entry == NULL; i++)
+        if (buffers[i].ptr == NULL)
+            entry = &buffers[i];
+    assert(entry);
 
-    if (my.output_mode == OUTPUT_VERBOSE)
+    switch (kind)
     {
-        struct results res;
-        generate_results(config, npeers, exec_time, &res);
-        print_results_verbose(config, -1, &res);
+    case BUFFER_MALLOC:
+        if (posix_memalign(&ptr, 4096, size) != 0)
+            ptr = NULL;
+        break;
+    case BUFFER_HUGE_2M:
+    case BUFFER_HUGE_1G:
+        ptr = allocate_huge(&size, kind);
+        break;
+    case BUFFER_MPI:
+        MPI_CHECK(MPI_Alloc_mem(size, MPI_INFO_NULL, &ptr));
+        break;
+    default:
+        assert(0);
     }
+    assert(ptr);
 
-    return exec_time;
+    bind_buffer(ptr, size);
+    touch_buffer(ptr, size, buffer_page_size(kind));
+
+    entry->ptr = ptr;
+    entry->size = size;
+    entry->kind = kind;
+    return ptr;
 }
 
-static double server(const struct test_config *config)
+static void destroy_buffer(void *ptr)
 {
-    double start, end;
+    struct buffer_entry *entry = NULL;
 
-    char *s_buffer      = config->s_buffer;
-    char *r_buffer      = config->r_buffer;
+    for (int i = 0; i < MAX_BUFFERS && entry == NULL; i++)
+        if (buffers[i].ptr == ptr)
+            entry = &buffers[i];
+    assert(entry);
 
-    int (*mpi_rma_func)(const void *origin_addr, int origin_count,
-                        MPI_Datatype origin_datatype, int target_rank,
-                        MPI_Aint target_disp, int target_count,
-                        MPI_Datatype target_datatype, MPI_Win win,
-                        MPI_Request *req);
-
-    /* Select which direction to use */
-    if (config->direction == DIR_PUT)
-        mpi_rma_func = MPI_Rput;
-    else if (config->direction == DIR_GET)
-        mpi_rma_func = MPI_Rput;
-    else
+    switch (entry->kind)
+    {
+    case BUFFER_MALLOC:
+        free(ptr);
+        break;
+    case BUFFER_HUGE_2M:
+    case BUFFER_HUGE_1G:
+        munmap(ptr, entry->size);
+        break;
+    case BUFFER_MPI:
+        MPI_CHECK(MPI_Free_mem(ptr));
+        break;
+    default:
         assert(0);
+    }
 
-    size_t nb_completed = 0;
-    const int nflight = MIN(NUM_RDMA_BUFFERS, (my.nclients * config->niters));
-    MPI_Request reqs[nflight];
-    enum rstate rstates[nflight];
-    int dst_ranks[nflight];
+    entry->ptr = NULL;
+}
 
-    /* Post all receive buffers to retrieve client's requests */
-    for (int i = 0; i < nflight; i++)
-    {
-        MPI_CHECK(MPI_Irecv(&r_buffer[i],
-                            1, MPI_CHAR,
-                            MPI_ANY_SOURCE,
-                            MPI_ANY_TAG,
-                            MPI_COMM_WORLD,
-                            &reqs[i]));
-        rstates[i] = STATE_REQ_POSTED;
-        dst_ranks[i] = MPI_RANK_ANY;
-    }
+static int hca_filter(const struct dirent *dev)
+{
+    return dev->d_name[0] != '.';
+}
 
-    MPI_Win_lock_all(0, config->rdma_win);
+/* NUMA node of the first HCA in name order (mlx5_0 before mlx5_1), as the
+ * order of readdir() is arbitrary, -1 when unknown */
+static int hca_numa_node(void)
+{
+    const char *dir = "/sys/class/infiniband";
+    char path[PATH_MAX];
+    struct dirent **devs;
+    int node = -1;
+    int ndevs = scandir(dir, &devs, hca_filter, alphasort);
 
-    start = MPI_Wtime();
+    if (ndevs < 0)
+        return -1;
 
-retry:
-    /* Make sure we progress all the requests in a fair way */
-    for (int i = 0; i < nflight; i++)
+    for (int i = 0; i < ndevs; i++)
     {
-        int flag;
-        MPI_Status status;
+        FILE *f;
 
-        if (reqs[i] == MPI_REQUEST_NULL)
+        snprintf(path, sizeof(path), "%s/%s/device/numa_node",
+                 dir, devs[i]->d_name);
+        f = fopen(path, "r");
+        if (f != NULL)
         {
-            assert(rstates[i] == STATE_REQ_NULL);
-            continue;
-        }
-
-        MPI_Test(&reqs[i], &flag, &status);
-        if (!flag)
-            continue;
-
-        switch (rstates[i])
-        {
-        case STATE_REQ_POSTED:
-            dst_ranks[i] = status.MPI_SOURCE;
-            assert(dst_ranks[i] >= 0 &&
-                   dst_ranks[i] < my.glob_size);
-
-            /* Start RMA operation */
-            void *base_ptr = (char *) config->rdma_buffer +
-                                      i * config->data_size;
-            MPI_CHECK(mpi_rma_func(base_ptr,
-                                   config->data_size,
-                                   MPI_CHAR,
-                                   status.MPI_SOURCE /* Rank of receiver */,
-                                   status.MPI_TAG /* Disp at receiver side */,
-                                   config->data_size,
-                                   MPI_CHAR,
-                                   config->rdma_win,
-                                   &reqs[i]));
-            rstates[i] = STATE_RDMA_POSTED;
+            if (fscanf(f, "%d", &node) != 1)
+                node = -1;
+            fclose(f);
             break;
+        }
+    }
 
-        case STATE_RDMA_POSTED:
-            assert(dst_ranks[i] >= 0 &&
-                   dst_ranks[i] < my.glob_size);
-            /* RMA completed, now send the response */
-            MPI_CHECK(MPI_Isend(&s_buffer[i],
-                                1, MPI_CHAR,
-                                dst_ranks[i],
-                                0, MPI_COMM_WORLD,
-                                &reqs[i]));
-            rstates[i] = STATE_RESP_POSTED;
-            break;
+    for (int i = 0; i < ndevs; i++)
+        free(devs[i]);
+    free(devs);
+    return node;
+}
 
-        case STATE_RESP_POSTED:
-            /* Response sent, now repost the recv buffer */
-            nb_completed++;
-            dst_ranks[i] = MPI_RANK_ANY;
+/* Payload integrity (--verify). A checked message starts with the 64-bit seed
+ * of its pattern and ends with the CRC32C of everything before it, so that
+ * the receiver detects corrupted or truncated data in a single pass over the
+ * buffer. Receivers clear the seed of their buffers before every transfer,
+ * and expect a seed derived from the ranks, slot and iteration, which also
+ * catches stale or misplaced data. One-sided Put regions shared by several
+ * initiators are the exception: their seed only holds the target rank, see
+ * rma_region_seed(). Messages too small to hold the seed and the CRC are not
+ * checked */
+#define VERIFY_MIN_SIZE (sizeof(uint64_t) + sizeof(uint32_t))
+#define CRC32C_POLY     0x82f63b78 /* Castagnoli, bit-reflected */
+#define CRC32C_BLOCK    4096       /* Bytes of each stream of the 3-way CRC */
+
+struct verify_stats
+{
+    uint64_t checked; /* Messages checked by the current rank */
+    uint64_t *errors; /* Corrupted messages, per source rank */
+};
 
-            if ((nb_completed + nflight) <=
-                my.nclients * config->niters)
-            {
-                MPI_CHECK(MPI_Irecv(&r_buffer[i],
-                                    1, MPI_CHAR,
-                                    MPI_ANY_SOURCE,
-                                    MPI_ANY_TAG,
-                                    MPI_COMM_WORLD,
-                                    &reqs[i]));
-                rstates[i] = STATE_REQ_POSTED;
-            }
-            else
-            {
-                reqs[i] = MPI_REQUEST_NULL;
-                rstates[i] = STATE_REQ_NULL;
+static uint32_t crc32c_table[256];
+static uint32_t crc32c_block_shift; /* x^(8 * CRC32C_BLOCK) mod P */
+static bool crc32c_has_hw;
 
-                /* End of test reached, now leaving */
-                if (my.nclients * config->niters == nb_completed)
-                    goto exit;
-            }
-            break;
+/* Product of two polynomials modulo P, bit-reflected */
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t) 1 << 31;
+    uint32_t p = 0;
 
-        case STATE_REQ_NULL:
-        /* fallthrough */
-        default:
-            fprintf(stderr, "Wrong state %d %d\n",
-                    rstates[i], i);
-            assert(0);
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
         }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
     }
 
-    /* Retry */
-//    MPI_CHECK(MPI_Win_flush_all(config->rdma_win));
-    goto retry;
+    return p;
+}
 
-exit:
-    MPI_Win_unlock_all(config->rdma_win);
-    end = MPI_Wtime();
+/* x^(8 * n) modulo P: multiplying a CRC register by it appends n zero bytes */
+static uint32_t crc32c_x8nmodp(size_t n)
+{
+    uint32_t p = (uint32_t) 1 << 31; /* x^0 */
+    uint32_t x8 = (uint32_t) 1 << 23; /* x^8 */
 
-    return end - start;
+    for (; n; n >>= 1)
+    {
+        if (n & 1)
+            p = crc32c_multmodp(x8, p);
+        x8 = crc32c_multmodp(x8, x8);
+    }
+
+    return p;
 }
 
-static void init_test(enum test_mode test_mode,
-                      const int curr_iter,
-                      const int niters,
-                      const int nflight,
-                      const int data_size,
-                      const enum direction direction,
-                      struct test_config *config)
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *buf, size_t len)
 {
-    config->test_mode = test_mode;
-    config->nflight   = nflight;
-    config->niters    = niters;
-    config->data_size = data_size;
-    config->direction = direction;
-    config->curr_iter = curr_iter;
+    while (len--)
+        crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+    return crc;
 }
 
-static double run_test_client_server(struct test_config *config,
-                                     struct results *res)
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw_1way(uint32_t crc, const unsigned char *buf,
+                               size_t len)
 {
-    /* Few barriers to sync everybody */
-    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
-    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
-    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    uint64_t c = crc;
 
-    if (is_server())
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t))
     {
-        /* each server waits for niters messages from each client */
-        return server(config);
+        uint64_t word;
+
+        memcpy(&word, buf, sizeof(word));
+        c = __builtin_ia32_crc32di(c, word);
+        buf += sizeof(word);
     }
-    else /* use all ranks >= nservers as the "clients" */
-        return client(config);
+
+    crc = c;
+    while (len--)
+        crc = __builtin_ia32_crc32qi(crc, *buf++);
+
+    return crc;
 }
 
-static void reduce_results_sum(struct results *invec, struct results *inoutvec,
-                               int *len, MPI_Datatype *dtype)
+/* The crc32 instruction has a latency of 3 cycles for a throughput of 1, so
+ * three independent streams are run at once on consecutive blocks, then
+ * merged by shifting the first ones past the next blocks */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *buf, size_t len)
 {
-    for (int i = 0; i < *len; i++)
+    for (; len >= 3 * CRC32C_BLOCK; len -= 3 * CRC32C_BLOCK)
     {
-        inoutvec[i].bw        += invec[i].bw;
-        inoutvec[i].latency   += invec[i].latency;
-        inoutvec[i].iops      += invec[i].iops;
-        inoutvec[i].exec_time += invec[i].exec_time;
+        uint64_t c0 = crc, c1 = 0, c2 = 0;
+
+        for (size_t i = 0; i < CRC32C_BLOCK; i += sizeof(uint64_t))
+        {
+            uint64_t w0, w1, w2;
+
+            memcpy(&w0, buf + i, sizeof(w0));
+            memcpy(&w1, buf + CRC32C_BLOCK + i, sizeof(w1));
+            memcpy(&w2, buf + 2 * CRC32C_BLOCK + i, sizeof(w2));
+            c0 = __builtin_ia32_crc32di(c0, w0);
+            c1 = __builtin_ia32_crc32di(c1, w1);
+            c2 = __builtin_ia32_crc32di(c2, w2);
+        }
+
+        crc = crc32c_multmodp(crc32c_block_shift, c0) ^ c1;
+        crc = crc32c_multmodp(crc32c_block_shift, crc) ^ c2;
+        buf += 3 * CRC32C_BLOCK;
     }
+
+    return crc32c_hw_1way(crc, buf, len);
 }
+#endif
 
-static void reduce_results_min(struct results *invec, struct results *inoutvec,
-                               int *len, MPI_Datatype *dtype)
+static void crc32c_init(void)
 {
-    for (int i = 0; i < *len; i++)
+    for (uint32_t i = 0; i < 256; i++)
     {
-        inoutvec[i].bw        = MIN(invec[i].bw,        inoutvec[i].bw);
-        inoutvec[i].latency   = MIN(invec[i].latency,   inoutvec[i].latency);
-        inoutvec[i].iops      = MIN(invec[i].iops,      inoutvec[i].iops);
-        inoutvec[i].exec_time = MIN(invec[i].exec_time, inoutvec[i].exec_time);
+        uint32_t crc = i;
+
+        for (int j = 0; j < 8; j++)
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[i] = crc;
     }
+
+    crc32c_block_shift = crc32c_x8nmodp(CRC32C_BLOCK);
+#if defined(__x86_64__)
+    crc32c_has_hw = __builtin_cpu_supports("sse4.2");
+#endif
 }
 
-static void reduce_results_max(struct results *invec, struct results *inoutvec,
-                               int *len, MPI_Datatype *dtype)
+/* Update a CRC register, which is not inverted */
+static uint32_t crc32c_update(uint32_t crc, const void *buf, size_t len)
 {
-    for (int i = 0; i < *len; i++)
-    {
-        inoutvec[i].bw        = MAX(invec[i].bw,        inoutvec[i].bw);
-        inoutvec[i].latency   = MAX(invec[i].latency,   inoutvec[i].latency);
-        inoutvec[i].iops      = MAX(invec[i].iops,      inoutvec[i].iops);
-        inoutvec[i].exec_time = MAX(invec[i].exec_time, inoutvec[i].exec_time);
-    }
+#if defined(__x86_64__)
+    if (crc32c_has_hw)
+        return crc32c_hw(crc, buf, len);
+#endif
+    return crc32c_sw(crc, buf, len);
 }
 
-static void init_mpi(int argc, char *argv[], const int nservers)
+static uint32_t crc32c(const void *buf, size_t len)
 {
-    MPI_Datatype dtype[4] = {MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
-    MPI_Aint disp[4] = {offsetof(struct results, bw),
-                        offsetof(struct results, latency),
-                        offsetof(struct results, iops),
-                        offsetof(struct results, exec_time)};
-    int blocklen[4] = {1, 1, 1, 1};
+    return ~crc32c_update(~0U, buf, len);
+}
 
-    MPI_CHECK(MPI_Init(&argc, &argv));
-
-    MPI_CHECK(MPI_Type_create_struct(4, blocklen, disp, dtype, &results_dtype));
-    MPI_CHECK(MPI_Type_commit(&results_dtype));
-
-    MPI_CHECK(MPI_Op_create((MPI_User_function *) reduce_results_sum, 1,
-                            &results_op[OP_SUM]));
-    MPI_CHECK(MPI_Op_create((MPI_User_function *) reduce_results_min, 1,
-                            &results_op[OP_MIN]));
-    MPI_CHECK(MPI_Op_create((MPI_User_function *) reduce_results_max, 1,
-                            &results_op[OP_MAX]));
+/* Seed of a message, never 0 so that a cleared buffer never matches */
+static inline uint64_t verify_seed(uint64_t a, uint64_t b, uint64_t c)
+{
+    uint64_t z = (a << 40) ^ (b << 20) ^ c;
 
-    MPI_CHECK(MPI_Comm_rank(MPI_COMM_WORLD, &my.glob_rank));
-    MPI_CHECK(MPI_Comm_size(MPI_COMM_WORLD, &my.glob_size));
+    /* splitmix64 finalizer */
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (z ^ (z >> 31)) | 1;
+}
 
-    MPI_Group clients_group;
-    MPI_Group world_group;
+/* CRC of a checked message. With --clock-sync, the send time stamp which
+ * follows the seed is written once the CRC is computed, so it is left out */
+static uint32_t verify_crc(const unsigned char *p, size_t body)
+{
+    const size_t skip = sizeof(uint64_t) + sizeof(double);
 
-    MPI_CHECK(MPI_Comm_group(MPI_COMM_WORLD, &world_group));
-    int clients_range[1][3] = {{nservers, my.glob_size - 1, 1}};
-    MPI_CHECK(MPI_Group_range_incl(world_group, 1, clients_range,
-                                   &clients_group));
+    if (!my.clock_sync || body < skip)
+        return crc32c(p, body);
 
-    MPI_CHECK(MPI_Comm_create_group(MPI_COMM_WORLD, clients_group, 0,
-                                    &clients_comm));
-    MPI_CHECK(MPI_Group_free(&clients_group));
-    MPI_CHECK(MPI_Group_free(&world_group));
+    return ~crc32c_update(crc32c_update(~0U, p, sizeof(uint64_t)),
+                          p + skip, body - skip);
 }
 
-static void destroy_mpi(void)
+/* Fill a message with the pattern of a seed, and its CRC */
+static void verify_fill(void *buf, size_t size, uint64_t seed)
 {
-    if (clients_comm != MPI_COMM_NULL)
+    unsigned char *p = buf;
+    const size_t body = size - sizeof(uint32_t);
+    size_t off = sizeof(seed);
+    uint64_t word;
+    uint32_t crc;
+
+    if (size < VERIFY_MIN_SIZE)
+        return;
+
+    memcpy(p, &seed, sizeof(seed));
+    for (; off + sizeof(word) <= body; off += sizeof(word))
     {
-        MPI_CHECK(MPI_Comm_free(&clients_comm));
-        clients_comm = MPI_COMM_NULL;
+        word = seed ^ (off * 0x9e3779b97f4a7c15ULL);
+        memcpy(p + off, &word, sizeof(word));
     }
+    word = seed ^ (off * 0x9e3779b97f4a7c15ULL);
+    memcpy(p + off, &word, body - off);
 
-    MPI_CHECK(MPI_Op_free(&results_op[OP_SUM]));
-    MPI_CHECK(MPI_Op_free(&results_op[OP_MIN]));
-    MPI_CHECK(MPI_Op_free(&results_op[OP_MAX]));
-    MPI_CHECK(MPI_Type_free(&results_dtype));
-    MPI_CHECK(MPI_Finalize());
+    crc = verify_crc(p, body);
+    memcpy(p + body, &crc, sizeof(crc));
 }
 
-static void print_results_reduced(const struct test_config *config,
-                                  const struct results *input_res)
+static inline void verify_clear(void *buf, size_t size)
 {
-    struct results output_res[_OP_LAST];
-    int split_comm_rank;
+    if (size >= VERIFY_MIN_SIZE)
+        memset(buf, 0, sizeof(uint64_t));
+}
 
-    /* Not part of client communicator: return */
-    if (clients_comm == MPI_COMM_NULL)
+/* Check a received message against the seed it should carry, and count it
+ * for the rank it came from */
+static void verify_check(struct verify_stats *stats, int src,
+                         const void *buf, size_t size, uint64_t seed)
+{
+    const unsigned char *p = buf;
+    const size_t body = size - sizeof(uint32_t);
+    uint64_t msg_seed;
+    uint32_t msg_crc;
+
+    if (size < VERIFY_MIN_SIZE)
         return;
 
-    MPI_CHECK(MPI_Comm_rank(clients_comm, &split_comm_rank));
-    for (int op = 0; op < _OP_LAST; ++op)
-        MPI_CHECK(MPI_Reduce(input_res, &output_res[op], 1, results_dtype,
-                             results_op[op], MPI_ROOT_RANK, clients_comm));
+    memcpy(&msg_seed, p, sizeof(msg_seed));
+    memcpy(&msg_crc, p + body, sizeof(msg_crc));
+
+    stats->checked++;
+    if (msg_seed != seed || verify_crc(p, body) != msg_crc)
+        stats->errors[src]++;
+}
+
+static struct verify_stats *alloc_verify_stats(void)
+{
+    struct verify_stats *stats;
+
+    if (!my.verify)
+        return NULL;
+
+    stats = malloc(sizeof(*stats));
+    assert(stats);
+    stats->errors = malloc(sizeof(uint64_t) * my.glob_size);
+    assert(stats->errors);
+    return stats;
+}
+
+static void reset_verify_stats(struct verify_stats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    stats->checked = 0;
+    memset(stats->errors, 0, sizeof(uint64_t) * my.glob_size);
+}
+
+static void free_verify_stats(struct verify_stats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    free(stats->errors);
+    free(stats);
+}
+
+/* Global clock (--clock-sync). The offset of every clock to the one of the
+ * root is estimated with ping-pongs: the round with the shortest round trip
+ * bounds the error to half of it. The estimate is refreshed before every
+ * size or monitoring interval, and the drift is derived from two estimates
+ * far enough apart */
+#define CLOCK_SYNC_ROUNDS    16
+#define CLOCK_DRIFT_MIN_SPAN 1.0 /* Seconds between two estimates */
+
+static struct
+{
+    /* The ping-pongs get their own communicator, so that the receives of
+     * a server still running never match them */
+    MPI_Comm comm;
+    bool global;      /* MPI_Wtime() is already synchronized */
+    int nsyncs;
+    double offset;    /* Root clock minus local clock, at 'sync_time' */
+    double drift;     /* Seconds of offset per second */
+    double sync_time; /* Local clock */
+    double rtt;       /* Round trip of the last estimate */
+} clock_state;
+
+static void clock_sync(void)
+{
+    double best_rtt = INFINITY, offset = 0, sync_time = 0;
 
-    if (split_comm_rank == MPI_ROOT_RANK)
+    if (clock_state.global)
+        return;
+
+    for (int r = 1; r < my.glob_size; r++)
     {
-        if (config->curr_iter == 0)
+        for (int i = 0; i < CLOCK_SYNC_ROUNDS; i++)
         {
-            fprintf(stdout, "                                  SUM                                     MIN                                      MAX                    \n");
-            fprintf(stdout, CONFIG_PRINT_HEADER" "
-                            RESULTS_PRINT_HEADER" "
-                            RESULTS_PRINT_HEADER" "
-                            RESULTS_PRINT_HEADER"\n");
-        }
+            double t0, t1, root_time;
 
-        fprintf(stdout, CONFIG_PRINT_FMT" "
-                        RESULTS_PRINT_FMT" "
-                        RESULTS_PRINT_FMT" "
-                        RESULTS_PRINT_FMT"\n",
-                        CONFIG_PRINT_ARGS(config),
-                        RESULTS_PRINT_ARGS(&output_res[OP_SUM]),
-                        RESULTS_PRINT_ARGS(&output_res[OP_MIN]),
-                        RESULTS_PRINT_ARGS(&output_res[OP_MAX]));
+            if (my.glob_rank == MPI_ROOT_RANK)
+            {
+                MPI_CHECK(MPI_Recv(NULL, 0, MPI_BYTE, r, 0,
+                                   clock_state.comm, MPI_STATUS_IGNORE));
+                root_time = MPI_Wtime();
+                MPI_CHECK(MPI_Send(&root_time, 1, MPI_DOUBLE, r, 0,
+                                   clock_state.comm));
+                continue;
+            }
+
+            if (my.glob_rank != r)
+                break;
+
+            t0 = MPI_Wtime();
+            MPI_CHECK(MPI_Send(NULL, 0, MPI_BYTE, MPI_ROOT_RANK, 0,
+                               clock_state.comm));
+            MPI_CHECK(MPI_Recv(&root_time, 1, MPI_DOUBLE, MPI_ROOT_RANK,
+                               0, clock_state.comm, MPI_STATUS_IGNORE));
+            t1 = MPI_Wtime();
+
+            if (t1 - t0 < best_rtt)
+            {
+                best_rtt = t1 - t0;
+                sync_time = (t0 + t1) / 2;
+                offset = root_time - sync_time;
+            }
+        }
     }
+
+    if (my.glob_rank == MPI_ROOT_RANK)
+        return;
+
+    if (clock_state.nsyncs > 0 &&
+        sync_time - clock_state.sync_time >= CLOCK_DRIFT_MIN_SPAN)
+        clock_state.drift = (offset - clock_state.offset) /
+                            (sync_time - clock_state.sync_time);
+    clock_state.offset = offset;
+    clock_state.sync_time = sync_time;
+    clock_state.rtt = best_rtt;
+    clock_state.nsyncs++;
 }
 
-static void help_usage(char *prog, FILE *stream)
+/* Time of the root clock at a local time */
+static inline double clock_to_global(double local)
 {
-    fprintf(stream, "IME Network Analysis Tool.\n\n");
-    fprintf(stream, "Usage: %s [OPTIONS]\n", basename(prog));
-    fprintf(stream, "\t-s, --nservers\tNumber of servers.\n");
-    fprintf(stream, "\t-i, --niters\tNumber of iterations.\n");
-    fprintf(stream, "\t-f, --nflight\tNumber of max inflight messages per client.\n");
-    fprintf(stream, "\t-b, --bsize\tSize of network buffers to test (in bytes).\n");
-    fprintf(stream, "\t-n, --hostnames\tEnable hostname resulution with verbose mode.\n");
-    fprintf(stream, "\t-v, --verbose\tEnable verbose mode.\n");
-    fprintf(stream, "\t-h, --help\tHelp page.\n");
+    return local + clock_state.offset +
+           clock_state.drift * (local - clock_state.sync_time);
 }
 
-static void parse_args(int argc, char *argv[])
+static void init_clock(void)
 {
-    static const struct option long_options[] = {
-        { "nservers",   required_argument, 0, 's' },
-        { "niters",     required_argument, 0, 'i' },
-        { "nflight",    required_argument, 0, 'f' },
-        { "help",       no_argument,       0, 'h' },
-        { "bsize",      required_argument, 0, 'b' },
-        { "hostnames",  no_argument,       0, 'n' },
-        { "sequential", no_argument,       0, 't' },
-        { "verbose",    no_argument,       0, 'v' },
-        { 0,            0,                 0, 0 }
-    };
+    int *is_global, flag = 0;
+    double local[2], max[2];
+
+    MPI_CHECK(MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_WTIME_IS_GLOBAL,
+                                &is_global, &flag));
+    clock_state.global = flag && *is_global;
+    MPI_CHECK(MPI_Comm_dup(MPI_COMM_WORLD, &clock_state.comm));
+
+    clock_sync();
+
+    local[0] = fabs(clock_state.offset);
+    local[1] = clock_state.rtt;
+    MPI_CHECK(MPI_Reduce(local, max, 2, MPI_DOUBLE, MPI_MAX, MPI_ROOT_RANK,
+                         MPI_COMM_WORLD));
+    if (my.glob_rank == MPI_ROOT_RANK)
+        fprintf(stdout, "# Clock sync: %s, max offset %.2f us, "
+                        "max error %.2f us\n",
+                clock_state.global ? "global MPI_Wtime" : "ping-pong",
+                max[0] * 1e6, max[1] / 2 * 1e6);
+}
 
-    while (1) {
-        int c = getopt_long(argc, argv, "s:i:h,f:,n,t",
-                        long_options, NULL);
-        if (c == -1)
-            break;
+/* One-way timing: senders stamp the messages with the global time they were
+ * posted at, right after the seed of --verify, and receivers subtract it
+ * from the global time they completed at. Each rank also keeps the global
+ * time it started and finished the current size at */
+struct one_way_stats
+{
+    struct histogram hist; /* One-way latency of the messages received */
+    double *sum;           /* Per source rank, in seconds */
+    uint64_t *count;
+    double start;          /* Global times, 0 until set */
+    double end;
+};
 
-        switch (c)
+static inline size_t stamp_offset(void)
+{
+    return my.verify ? sizeof(uint64_t) : 0;
+}
+
+/* The stamp must not overlap the CRC of --verify either */
+static inline bool stamp_fits(size_t size)
+{
+    return size >= stamp_offset() + sizeof(double) +
+                   (my.verify ? sizeof(uint32_t) : 0);
+}
+
+static inline void stamp_message(void *buf, size_t size, double local)
+{
+    const double stamp = clock_to_global(local);
+
+    if (stamp_fits(size))
+        memcpy((char *) buf + stamp_offset(), &stamp, sizeof(stamp));
+}
+
+static void record_one_way(struct one_way_stats *stats, int src,
+                           const void *buf, size_t size, double local)
+{
+    double stamp, latency;
+
+    if (!stamp_fits(size))
+        return;
+
+    memcpy(&stamp, (const char *) buf + stamp_offset(), sizeof(stamp));
+    latency = MAX(clock_to_global(local) - stamp, 0);
+    hist_record(&stats->hist, latency);
+    stats->sum[src] += latency;
+    stats->count[src]++;
+}
+
+static inline void one_way_mark(struct one_way_stats *stats, double start,
+                                double end)
+{
+    if (stats == NULL)
+        return;
+
+    if (stats->start == 0)
+        stats->start = clock_to_global(start);
+    stats->end = clock_to_global(end);
+}
+
+static struct one_way_stats *alloc_one_way_stats(void)
+{
+    struct one_way_stats *stats;
+
+    if (!my.clock_sync)
+        return NULL;
+
+    stats = malloc(sizeof(*stats));
+    assert(stats);
+    stats->sum = malloc(sizeof(double) * my.glob_size);
+    stats->count = malloc(sizeof(uint64_t) * my.glob_size);
+    assert(stats->sum && stats->count);
+    return stats;
+}
+
+static void reset_one_way_stats(struct one_way_stats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    hist_reset(&stats->hist);
+    memset(stats->sum, 0, sizeof(double) * my.glob_size);
+    memset(stats->count, 0, sizeof(uint64_t) * my.glob_size);
+    stats->start = stats->end = 0;
+}
+
+static void free_one_way_stats(struct one_way_stats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    free(stats->sum);
+    free(stats->count);
+    free(stats);
+}
+
+/* Counters of the RPCs between a client and a server, kept on both sides:
+ * clients time the whole RPC, servers the time from the request to the
+ * response. They are doubles so that they reduce and print as such */
+struct pair_stats
+{
+    double ops;
+    double bytes;
+    double time;     /* Sum of the RPC times, in seconds */
+    double max_time;
+    double first;    /* Post of the first RPC */
+    double last;     /* Completion of the last RPC */
+};
+
+#define PAIR_STATS_NVALUES (sizeof(struct pair_stats) / sizeof(double))
+
+static inline void pair_record(struct pair_stats *pair, size_t size,
+                               double start, double end)
+{
+    pair->first = pair->ops ? MIN(pair->first, start) : start;
+    pair->last = MAX(pair->last, end);
+    pair->ops++;
+    pair->bytes += size;
+    pair->time += end - start;
+    pair->max_time = MAX(pair->max_time, end - start);
+}
+
+static struct pair_flows *alloc_pair_flows(void)
+{
+    struct pair_flows *flows = malloc(sizeof(*flows));
+
+    assert(flows);
+    flows->mb = calloc(my.glob_size, sizeof(double));
+    flows->time = calloc(my.glob_size, sizeof(double));
+    flows->step_time = calloc(my.glob_size, sizeof(double));
+    assert(flows->mb && flows->time && flows->step_time);
+    return flows;
+}
+
+static void free_pair_flows(struct pair_flows *flows)
+{
+    free(flows->mb);
+    free(flows->time);
+    free(flows->step_time);
+    free(flows);
+}
+
+/* Start the bandwidth of the flows over */
+static void reset_pair_flows(const struct test_config *config)
+{
+    if (config->pair_bw == NULL)
+        return;
+
+    memset(config->flows->mb, 0, sizeof(double) * my.glob_size);
+    memset(config->flows->time, 0, sizeof(double) * my.glob_size);
+}
+
+static void reset_pairs(const struct test_config *config)
+{
+    if (config->test_mode != TEST_MODE_CLIENT_SERVER)
+    {
+        reset_pair_flows(config);
+        return;
+    }
+
+    memset(config->pairs, 0, sizeof(struct pair_stats) *
+                             (is_server() ? my.nclients : my.nservers));
+}
+
+/* Results of a single pair: its bandwidth over the wall time of its RPCs,
+ * as they overlap with up to nflight others, and their latency */
+static void generate_results_pair(const struct pair_stats *pair,
+                                  double exec_time, struct results *res)
+{
+    if (pair->ops == 0 || pair->last <= pair->first)
+    {
+        memset(res, 0, sizeof(*res));
+        return;
+    }
+
+    res->bw = pair->bytes / (1024 * 1024 * (pair->last - pair->first));
+    res->latency = pair->time / pair->ops * 1e6;
+    res->iops = exec_time > 0 ? pair->ops / exec_time : 0;
+    res->exec_time = exec_time;
+}
+
+/* Create the persistent requests of every (peer, slot) RPC, laid out as the
+ * reqs of client_post_rpc() for each peer */
+static MPI_Request *client_init_rpcs(const int npeers, const int nflight,
+                                     char *s_buffer, char *r_buffer)
+{
+    MPI_Request *rpcs = malloc(sizeof(MPI_Request) * npeers * nflight * 2);
+    assert(rpcs);
+
+    for (int peer = 0; peer < npeers; peer++)
+    {
+        for (int slot = 0; slot < nflight; slot++)
         {
-            case 's':
-                my.nservers = atoi(optarg);
-                break;
-            case 'i':
-                my.niters = atoi(optarg);
-                break;
-            case 'f':
-                my.nflight = atoi(optarg);
-                break;
-            case 'b':
-                my.bsize = atoi(optarg);
-                break;
-            case 'n':
-                my.hostname_resolve = true;
-                break;
-            case 't':
-                my.sequential_ios = true;
-                break;
-            case 'h':
-                help_usage(argv[0], stdout);
-                exit(EXIT_SUCCESS);
-                break;
-            case 'v':
-                my.output_mode = OUTPUT_VERBOSE;
-                break;
-            default:
-                fprintf(stderr, "Invalid argument: %s\n", optarg);
-                help_usage(argv[0], stderr);
-                exit(EXIT_FAILURE);
+            MPI_Request *rpc = &rpcs[((size_t) peer * nflight + slot) * 2];
+
+            MPI_CHECK(MPI_Recv_init(&r_buffer[slot], 1, MPI_CHAR, peer, slot,
+                                    MPI_COMM_WORLD, &rpc[0]));
+            MPI_CHECK(MPI_Send_init(&s_buffer[slot], 1, MPI_CHAR, peer, slot,
+                                    MPI_COMM_WORLD, &rpc[1]));
         }
     }
+
+    return rpcs;
 }
 
-static void test_client_server(int start_size, int end_size,
-                               enum direction direction)
+static void free_persistent(MPI_Request *reqs, size_t count)
 {
-    int curr_size;
-    int curr_iter = 0;
-    struct test_config test_config;
+    for (size_t i = 0; i < count; i++)
+        if (reqs[i] != MPI_REQUEST_NULL)
+            MPI_CHECK(MPI_Request_free(&reqs[i]));
+    free(reqs);
+}
+
+/* Post one RPC on the given client slot: the response receive and the
+ * request itself. The displacement to use is encoded into the MPI TAG and the
+ * server replies with the same tag, so that every slot gets its own
+ * response. With persistent requests ('rpcs' not NULL), the ones of the slot
+ * and peer are only started */
+static void client_post_rpc(const int slot, const int peer,
+                            char *s_buffer, char *r_buffer,
+                            const MPI_Request *rpcs, const int nflight,
+                            MPI_Request *reqs)
+{
+    if (rpcs)
+    {
+        const MPI_Request *rpc = &rpcs[((size_t) peer * nflight + slot) * 2];
 
-    int nflight = is_server() ? NUM_RDMA_BUFFERS : my.nflight;
-    const int win_size = end_size * nflight;
+        reqs[slot * 2] = rpc[0];
+        reqs[slot * 2 + 1] = rpc[1];
+        MPI_CHECK(MPI_Startall(2, &reqs[slot * 2]));
+        return;
+    }
 
-    /* Allocate buffers */
-    test_config.s_buffer = allocate_buffer(nflight);
-    test_config.r_buffer = allocate_buffer(nflight);
+    MPI_CHECK(MPI_Irecv(&r_buffer[slot], 1,
+                        MPI_CHAR, peer,
+                        slot,
+                        MPI_COMM_WORLD,
+                        &reqs[slot * 2]));
+
+    MPI_CHECK(MPI_Isend(&s_buffer[slot], 1,
+                        MPI_CHAR, peer,
+                        slot, /* MPI TAG = displacement */
+                        MPI_COMM_WORLD,
+                        &reqs[slot * 2 + 1]));
+}
 
-    MPI_CHECK(MPI_Win_allocate(win_size,
-                               end_size, /* disp unit */
-                               MPI_INFO_NULL,
-                               MPI_COMM_WORLD,
-                               &test_config.rdma_buffer,
-                               &test_config.rdma_win));
+/* Seed of the payload of an RPC. With --verify, the client bumps the 1-byte
+ * request of the slot for every RPC, and the server reads it back */
+static inline uint64_t rpc_seed(int client, int slot, int server,
+                                unsigned char token)
+{
+    return verify_seed(client, slot, ((uint64_t) server << 8) | token);
+}
 
-    /* Warmup test */
-    init_test(TEST_MODE_CLIENT_SERVER,
-              -1, NUM_RDMA_BUFFERS, nflight, 1, direction, &test_config);
-    run_test_client_server(&test_config, NULL);
+/* Get the window region of a slot ready for its next RPC: cleared for Put,
+ * filled with the pattern for Get */
+static void client_verify_prepare(const struct test_config *config,
+                                  int slot, int peer)
+{
+    unsigned char *token = (unsigned char *) config->s_buffer + slot;
+    char *data = (char *) config->rdma_buffer +
+                 (size_t) slot * config->slot_size;
+
+    ++*token;
+    if (config->direction == DIR_PUT)
+        verify_clear(data, config->data_size);
+    else
+        verify_fill(data, config->data_size,
+                    rpc_seed(my.glob_rank, slot, peer, *token));
+}
+
+/* Check the data put by the server once the RPC of a slot completed */
+static void client_verify_complete(const struct test_config *config,
+                                   int slot, int peer)
+{
+    const unsigned char *token = (unsigned char *) config->s_buffer + slot;
+
+    if (config->direction != DIR_PUT)
+        return;
+
+    verify_check(config->verify, peer,
+                 (char *) config->rdma_buffer +
+                 (size_t) slot * config->slot_size,
+                 config->data_size,
+                 rpc_seed(my.glob_rank, slot, peer, *token));
+}
+
+static double client(const struct test_config *config)
+{
+    double start, end;
+    int npeers = my.nservers;
+    double exec_time;
+
+    const int nflight   = config->nflight;
+    const int niters    = config->niters;
+    char *s_buffer      = config->s_buffer;
+    char *r_buffer      = config->r_buffer;
+
+    MPI_Request reqs[nflight * 2];
+    int indices[nflight * 2];
+    int pending[nflight]; /* Number of uncompleted reqs per slot */
+    double stamps[nflight]; /* Post time of the RPC of each slot */
+    int slot_peers[nflight]; /* Server of the RPC of each slot */
+    const int total = niters * npeers;
+    int posted = 0;
+    int completed = 0;
+    int k = 0;
+    MPI_Request *rpcs = NULL;
+
+    if (my.output_mode == OUTPUT_VERBOSE)
+        print_header_verbose(config);
+
+    /* Set up the requests out of the timed loop */
+    if (my.persistent)
+        rpcs = client_init_rpcs(npeers, nflight, s_buffer, r_buffer);
+
+    MPI_CHECK(MPI_Barrier(clients_comm));
+
+    start = MPI_Wtime();
 
-    for (curr_size = start_size; curr_size <= end_size; curr_size *= 2)
+    if (my.batch_mode)
     {
-        struct results res;
+        for (int j = 0; j < niters; j++)
+        {
+            for (int peer = 0; peer < npeers; peer++)
+            {
+                stamps[k] = MPI_Wtime();
+                slot_peers[k] = peer;
+                if (config->verify)
+                    client_verify_prepare(config, k, peer);
+                client_post_rpc(k, peer, s_buffer, r_buffer, rpcs, nflight,
+                                reqs);
+
+                /* Nflight reached, now wait for all reqs to complete */
+                if (++k >= nflight)
+                {
+                    /* Wait for all Isend/Irecv to complete */
+                    MPI_CHECK(MPI_Waitall(k * 2, reqs, MPI_STATUSES_IGNORE));
+                    end = MPI_Wtime();
+                    for (int i = 0; i < k; i++)
+                    {
+                        hist_record(config->hist, end - stamps[i]);
+                        pair_record(&config->pairs[slot_peers[i]],
+                                    config->data_size, stamps[i], end);
+                        if (config->verify)
+                            client_verify_complete(config, i, slot_peers[i]);
+                    }
+                    k = 0;
+                }
+            }
+        }
+
+        MPI_CHECK(MPI_Waitall(k * 2, reqs, MPI_STATUSES_IGNORE));
+        end = MPI_Wtime();
+        for (int i = 0; i < k; i++)
+        {
+            hist_record(config->hist, end - stamps[i]);
+            pair_record(&config->pairs[slot_peers[i]], config->data_size,
+                        stamps[i], end);
+            if (config->verify)
+                client_verify_complete(config, i, slot_peers[i]);
+        }
+    }
+    else
+    {
+        /* Sliding window: fill all the slots, then refill each slot as soon
+         * as its RPC completes, so that nflight RPCs are always outstanding */
+        for (k = 0; k < nflight; k++)
+        {
+            if (posted < total)
+            {
+                slot_peers[k] = posted++ % npeers;
+                if (config->verify)
+                    client_verify_prepare(config, k, slot_peers[k]);
+                stamps[k] = MPI_Wtime();
+                client_post_rpc(k, slot_peers[k], s_buffer, r_buffer,
+                                rpcs, nflight, reqs);
+                pending[k] = 2;
+            }
+            else
+            {
+                reqs[k * 2] = reqs[k * 2 + 1] = MPI_REQUEST_NULL;
+                pending[k] = 0;
+            }
+        }
+
+        while (completed < total)
+        {
+            int outcount;
+
+            MPI_CHECK(MPI_Waitsome(nflight * 2, reqs, &outcount, indices,
+                                   MPI_STATUSES_IGNORE));
+            assert(outcount != MPI_UNDEFINED);
+            end = MPI_Wtime();
+
+            for (int i = 0; i < outcount; i++)
+            {
+                const int slot = indices[i] / 2;
+
+                if (--pending[slot] > 0)
+                    continue;
+
+                hist_record(config->hist, end - stamps[slot]);
+                pair_record(&config->pairs[slot_peers[slot]],
+                            config->data_size, stamps[slot], end);
+                if (config->verify)
+                    client_verify_complete(config, slot, slot_peers[slot]);
+                completed++;
+                if (posted < total)
+                {
+                    slot_peers[slot] = posted++ % npeers;
+                    if (config->verify)
+                        client_verify_prepare(config, slot, slot_peers[slot]);
+                    /* Not 'end': the slots completed before this one
+                     * were refilled in between */
+                    stamps[slot] = MPI_Wtime();
+                    client_post_rpc(slot, slot_peers[slot],
+                                    s_buffer, r_buffer, rpcs, nflight, reqs);
+                    pending[slot] = 2;
+                }
+            }
+        }
+    }
+
+    end = MPI_Wtime();
+    exec_time = (end - start);
+    one_way_mark(config->one_way, start, end);
+
+    if (rpcs)
+        free_persistent(rpcs, (size_t) npeers * nflight * 2);
+
+    if (my.output_mode == OUTPUT_VERBOSE)
+    {
+        struct results res;
+        generate_results(config, npeers, exec_time, &res);
+        print_results_verbose(config, -1, &res);
+
+        /* Then every server on its own, to single out a slow one */
+        for (int peer = 0; peer < npeers; peer++)
+        {
+            generate_results_pair(&config->pairs[peer], exec_time, &res);
+            print_results_verbose(config, peer, &res);
+        }
+    }
+
+    return exec_time;
+}
+
+/* Start the RMA transfer of a server slot: Put writes the server buffer into
+ * the client window, Get reads the client window into the server buffer */
+static void server_post_rma(const struct test_config *config,
+                            void *base_ptr,
+                            const int target_rank,
+                            const MPI_Aint target_disp,
+                            MPI_Request *req)
+{
+    switch (config->direction)
+    {
+    case DIR_PUT:
+        MPI_CHECK(MPI_Rput(base_ptr,
+                           config->data_count,
+                           config->data_type,
+                           target_rank,
+                           target_disp,
+                           config->data_count,
+                           config->data_type,
+                           config->rdma_win,
+                           req));
+        break;
+
+    case DIR_GET:
+        MPI_CHECK(MPI_Rget(base_ptr,
+                           config->data_count,
+                           config->data_type,
+                           target_rank,
+                           target_disp,
+                           config->data_count,
+                           config->data_type,
+                           config->rdma_win,
+                           req));
+        break;
+
+    default:
+        assert(0);
+    }
+}
+
+/* Post the receive of a client request on a server slot. With persistent
+ * requests ('recvs' not NULL), the one of the slot is only started */
+static void server_post_recv(const int slot, char *r_buffer,
+                             const MPI_Request *recvs, MPI_Request *reqs)
+{
+    if (recvs)
+    {
+        reqs[slot] = recvs[slot];
+        MPI_CHECK(MPI_Start(&reqs[slot]));
+        return;
+    }
+
+    MPI_CHECK(MPI_Irecv(&r_buffer[slot],
+                        1, MPI_CHAR,
+                        MPI_ANY_SOURCE,
+                        MPI_ANY_TAG,
+                        MPI_COMM_WORLD,
+                        &reqs[slot]));
+}
+
+static double server(const struct test_config *config)
+{
+    double start, end;
+
+    char *s_buffer      = config->s_buffer;
+    char *r_buffer      = config->r_buffer;
+
+    assert(config->direction == DIR_PUT || config->direction == DIR_GET);
+
+    size_t nb_completed = 0;
+    const size_t nb_total = (size_t) my.nclients * config->niters;
+    const int nflight = (int) MIN((size_t) config->nflight, nb_total);
+    /* Per-slot state, on the heap since --server-slots is unbounded */
+    MPI_Request *reqs = malloc(sizeof(*reqs) * nflight);
+    MPI_Status *statuses = malloc(sizeof(*statuses) * nflight);
+    int *indices = malloc(sizeof(*indices) * nflight);
+    enum rstate *rstates = malloc(sizeof(*rstates) * nflight);
+    int *dst_ranks = malloc(sizeof(*dst_ranks) * nflight);
+    int *dst_tags = malloc(sizeof(*dst_tags) * nflight);
+    /* Arrival time of the request of each slot */
+    double *stamps = malloc(sizeof(*stamps) * nflight);
+    /* Payload seed of each slot, with --verify */
+    uint64_t *seeds = malloc(sizeof(*seeds) * nflight);
+    MPI_Request *recvs = NULL;
+
+    assert(reqs && statuses && indices && rstates && dst_ranks && dst_tags &&
+           stamps && seeds);
+
+    /* Only the receives of the requests can be persistent: the RMA
+     * operations have no persistent flavor, and the destination of the
+     * responses changes from one RPC to the next one */
+    if (my.persistent)
+    {
+        recvs = malloc(sizeof(MPI_Request) * nflight);
+        assert(recvs);
+
+        for (int i = 0; i < nflight; i++)
+            MPI_CHECK(MPI_Recv_init(&r_buffer[i], 1, MPI_CHAR,
+                                    MPI_ANY_SOURCE, MPI_ANY_TAG,
+                                    MPI_COMM_WORLD, &recvs[i]));
+    }
+
+    /* Post all receive buffers to retrieve client's requests */
+    for (int i = 0; i < nflight; i++)
+    {
+        server_post_recv(i, r_buffer, recvs, reqs);
+        rstates[i] = STATE_REQ_POSTED;
+        dst_ranks[i] = MPI_RANK_ANY;
+    }
+
+    MPI_Win_lock_all(0, config->rdma_win);
+
+    start = MPI_Wtime();
+
+    /* Progress all the slots at once: every call completes a batch of
+     * requests, which are then moved to the next state of the RPC */
+    while (nb_completed < nb_total)
+    {
+        int outcount;
+        double now;
+
+        if (my.server_blocking)
+            MPI_CHECK(MPI_Waitsome(nflight, reqs, &outcount, indices,
+                                   statuses));
+        else
+            MPI_CHECK(MPI_Testsome(nflight, reqs, &outcount, indices,
+                                   statuses));
+
+        /* All the slots are inactive, which can not happen before the
+         * end of the test */
+        assert(outcount != MPI_UNDEFINED);
+        if (outcount == 0)
+            continue;
+        now = MPI_Wtime();
+
+        for (int j = 0; j < outcount; j++)
+        {
+            const int i = indices[j];
+            const MPI_Status *status = &statuses[j];
+
+            switch (rstates[i])
+            {
+            case STATE_REQ_POSTED:
+                dst_ranks[i] = status->MPI_SOURCE;
+                dst_tags[i] = status->MPI_TAG;
+                stamps[i] = now;
+                assert(dst_ranks[i] >= 0 &&
+                       dst_ranks[i] < my.glob_size);
+
+                /* Start RMA operation */
+                void *base_ptr = (char *) config->rdma_buffer +
+                                          (size_t) i * config->data_size;
+                if (config->verify)
+                {
+                    seeds[i] = rpc_seed(dst_ranks[i], dst_tags[i],
+                                        my.glob_rank,
+                                        (unsigned char) r_buffer[i]);
+                    if (config->direction == DIR_PUT)
+                        verify_fill(base_ptr, config->data_size, seeds[i]);
+                    else
+                        verify_clear(base_ptr, config->data_size);
+                }
+                server_post_rma(config, base_ptr,
+                                status->MPI_SOURCE /* Rank of receiver */,
+                                /* The tag is the slot at receiver side */
+                                (MPI_Aint) status->MPI_TAG *
+                                config->slot_size,
+                                &reqs[i]);
+                rstates[i] = STATE_RDMA_POSTED;
+                break;
+
+            case STATE_RDMA_POSTED:
+                assert(dst_ranks[i] >= 0 &&
+                       dst_ranks[i] < my.glob_size);
+                /* An Rput only completes locally: the data has to reach the
+                 * client before its response to be checked there */
+                if (config->verify && config->direction == DIR_PUT)
+                    MPI_CHECK(MPI_Win_flush(dst_ranks[i], config->rdma_win));
+                else if (config->verify)
+                    verify_check(config->verify, dst_ranks[i],
+                                 (char *) config->rdma_buffer +
+                                 (size_t) i * config->data_size,
+                                 config->data_size, seeds[i]);
+                /* RMA completed, now send the response on the client slot */
+                MPI_CHECK(MPI_Isend(&s_buffer[i],
+                                    1, MPI_CHAR,
+                                    dst_ranks[i],
+                                    dst_tags[i], MPI_COMM_WORLD,
+                                    &reqs[i]));
+                rstates[i] = STATE_RESP_POSTED;
+                break;
+
+            case STATE_RESP_POSTED:
+                /* Response sent, now repost the recv buffer */
+                nb_completed++;
+                pair_record(&config->pairs[dst_ranks[i] - my.nservers],
+                            config->data_size, stamps[i], now);
+                dst_ranks[i] = MPI_RANK_ANY;
+
+                if ((nb_completed + nflight) <= nb_total)
+                {
+                    server_post_recv(i, r_buffer, recvs, reqs);
+                    rstates[i] = STATE_REQ_POSTED;
+                }
+                else
+                {
+                    /* Testsome/Waitsome already set reqs[i] to
+                     * MPI_REQUEST_NULL */
+                    rstates[i] = STATE_REQ_NULL;
+                }
+                break;
+
+            case STATE_REQ_NULL:
+            /* fallthrough */
+            default:
+                fprintf(stderr, "Wrong state %d %d\n",
+                        rstates[i], i);
+                assert(0);
+            }
+        }
+    }
+
+    MPI_Win_unlock_all(config->rdma_win);
+    end = MPI_Wtime();
+
+    if (recvs)
+        free_persistent(recvs, nflight);
+
+    free(reqs);
+    free(statuses);
+    free(indices);
+    free(rstates);
+    free(dst_ranks);
+    free(dst_tags);
+    free(stamps);
+    free(seeds);
+
+    return end - start;
+}
+
+/* Messages are described as a count of a datatype, which keeps the sizes
+ * beyond INT_MAX bytes within the int counts of the MPI calls: they are
+ * made of chunks of MSG_CHUNK_SIZE bytes, plus the remainder */
+#define MSG_CHUNK_SIZE ((size_t) 1 << 30)
+
+static void msg_type_create(size_t size, MPI_Datatype *type, int *count)
+{
+    MPI_Datatype chunk;
+
+    if (size <= INT_MAX)
+    {
+        *type = MPI_CHAR;
+        *count = size;
+        return;
+    }
+
+    MPI_CHECK(MPI_Type_contiguous(MSG_CHUNK_SIZE, MPI_CHAR, &chunk));
+
+    if (size % MSG_CHUNK_SIZE == 0)
+    {
+        *type = chunk;
+        *count = size / MSG_CHUNK_SIZE;
+    }
+    else
+    {
+        int blocklens[2] = { size / MSG_CHUNK_SIZE, size % MSG_CHUNK_SIZE };
+        MPI_Aint displs[2] = { 0, (MPI_Aint) (size / MSG_CHUNK_SIZE) *
+                                  MSG_CHUNK_SIZE };
+        MPI_Datatype types[2] = { chunk, MPI_CHAR };
+
+        MPI_CHECK(MPI_Type_create_struct(2, blocklens, displs, types, type));
+        MPI_CHECK(MPI_Type_free(&chunk));
+        *count = 1;
+    }
+
+    MPI_CHECK(MPI_Type_commit(type));
+}
+
+static void msg_type_free(MPI_Datatype *type)
+{
+    if (*type != MPI_CHAR)
+        MPI_CHECK(MPI_Type_free(type));
+    *type = MPI_CHAR;
+}
+
+static void init_test(enum test_mode test_mode,
+                      const int curr_iter,
+                      const int niters,
+                      const int nflight,
+                      const size_t data_size,
+                      const enum direction direction,
+                      struct test_config *config)
+{
+    config->test_mode = test_mode;
+    config->nflight   = nflight;
+    config->niters    = niters;
+    config->data_size = data_size;
+    msg_type_free(&config->data_type);
+    msg_type_create(data_size, &config->data_type, &config->data_count);
+    config->direction = direction;
+    config->curr_iter = curr_iter;
+    for (int c = 0; c < _LINK_LAST; c++)
+        hist_reset(&config->hist[c]);
+    reset_verify_stats(config->verify);
+    reset_one_way_stats(config->one_way);
+    reset_pairs(config);
+}
+
+/* Time-budgeted runs: a probe measures the time of one iteration of the
+ * current size, then the size runs in CALIB_NBATCHES batches sized to fill
+ * the budget. It stops early once the 95% confidence interval of the batch
+ * bandwidths is narrow enough */
+#define CALIB_NBATCHES    10
+#define CALIB_MIN_BATCHES 3
+#define CALIB_MAX_NITERS  (1 << 24)
+
+/* Run one batch of 'config->niters' iterations. Each caller accumulates
+ * what it needs to report in 'arg' */
+typedef void (*batch_fn)(struct test_config *config, void *arg);
+
+/* Two-sided 95% quantile of the Student t distribution, by degrees of
+ * freedom */
+static double student_t95(int df)
+{
+    static const double t95[] = {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+        2.086,
+    };
+
+    if (df < (int) (sizeof(t95) / sizeof(t95[0])))
+        return t95[df];
+    return 1.96;
+}
+
+/* Run one batch and return the time of the slowest rank */
+static double run_batch(struct test_config *config, batch_fn run, void *arg)
+{
+    double elapsed = MPI_Wtime();
+
+    run(config, arg);
+    elapsed = MPI_Wtime() - elapsed;
+
+    MPI_CHECK(MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+                            MPI_COMM_WORLD));
+    return elapsed;
+}
+
+/* Run the current size within the time budget. The decisions are made on
+ * reduced values, so that all the ranks, servers included, run the same
+ * batches. On return, 'config->niters' is the number of iterations of all
+ * the batches, which 'arg' accumulated, and the histograms hold all of them */
+static void run_calibrated(struct test_config *config, batch_fn run,
+                           void *probe_arg, void *arg)
+{
+    const double budget = my.time_per_size;
+    double sum = 0, sum2 = 0, elapsed;
+    int batch_niters, total_niters = 0;
+    int nbatches = 0;
+
+    /* Probe with a full client window, then start over with clean
+     * histograms. Servers have their own window, while the number of
+     * iterations must be the same everywhere */
+    config->niters = my.nflight;
+    elapsed = run_batch(config, run, probe_arg) / config->niters;
+    for (int c = 0; c < _LINK_LAST; c++)
+        hist_reset(&config->hist[c]);
+    reset_pairs(config);
+
+    for (double spent = 0; spent < budget && nbatches < CALIB_NBATCHES * 2;)
+    {
+        double rate;
+
+        /* Size the batch from the last measure, which gets more accurate
+         * than the probe once a whole batch ran */
+        batch_niters = MIN((budget / CALIB_NBATCHES) / MAX(elapsed, 1e-9),
+                           CALIB_MAX_NITERS);
+        config->niters = batch_niters = MAX(batch_niters, 1);
+
+        elapsed = run_batch(config, run, arg);
+        spent += elapsed;
+        total_niters += batch_niters;
+        nbatches++;
+
+        /* The rate of iterations is proportional to the bandwidth */
+        rate = batch_niters / elapsed;
+        elapsed /= batch_niters;
+        sum += rate;
+        sum2 += rate * rate;
+
+        if (nbatches >= CALIB_MIN_BATCHES && my.ci_target > 0)
+        {
+            const double mean = sum / nbatches;
+            const double var = MAX(sum2 / nbatches - mean * mean, 0) *
+                               nbatches / (nbatches - 1);
+            const double half = student_t95(nbatches - 1) *
+                                sqrt(var / nbatches);
+
+            if (half / mean <= my.ci_target / 100)
+                break;
+        }
+    }
+
+    config->niters = total_niters;
+}
+
+static double run_test_client_server(struct test_config *config,
+                                     struct results *res)
+{
+    /* Few barriers to sync everybody */
+    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+
+    if (is_server())
+    {
+        /* each server waits for niters messages from each client */
+        return server(config);
+    }
+    else /* use all ranks >= nservers as the "clients" */
+        return client(config);
+}
+
+static void results_sum(const struct results *in, struct results *inout)
+{
+    inout->bw        += in->bw;
+    inout->latency   += in->latency;
+    inout->iops      += in->iops;
+    inout->exec_time += in->exec_time;
+}
+
+static bool results_is_empty(const struct results *res)
+{
+    return res->exec_time == 0;
+}
+
+static void results_min(const struct results *in, struct results *inout)
+{
+    inout->bw        = MIN(in->bw,        inout->bw);
+    inout->latency   = MIN(in->latency,   inout->latency);
+    inout->iops      = MIN(in->iops,      inout->iops);
+    inout->exec_time = MIN(in->exec_time, inout->exec_time);
+}
+
+static void results_max(const struct results *in, struct results *inout)
+{
+    inout->bw        = MAX(in->bw,        inout->bw);
+    inout->latency   = MAX(in->latency,   inout->latency);
+    inout->iops      = MAX(in->iops,      inout->iops);
+    inout->exec_time = MAX(in->exec_time, inout->exec_time);
+}
+
+/* Contribution of a rank to the reduction of the results */
+static void results_reduced_init(const struct results *res,
+                                 struct results_reduced *reduced)
+{
+    reduced->sum = reduced->min = reduced->max = *res;
+    reduced->count = !results_is_empty(res);
+}
+
+static void reduce_results(struct results_reduced *invec,
+                           struct results_reduced *inoutvec,
+                           int *len, MPI_Datatype *dtype)
+{
+    for (int i = 0; i < *len; i++)
+    {
+        results_sum(&invec[i].sum, &inoutvec[i].sum);
+        if (invec[i].count == 0)
+            continue;
+        if (inoutvec[i].count == 0)
+        {
+            inoutvec[i].min = invec[i].min;
+            inoutvec[i].max = invec[i].max;
+        }
+        else
+        {
+            results_min(&invec[i].min, &inoutvec[i].min);
+            results_max(&invec[i].max, &inoutvec[i].max);
+        }
+        inoutvec[i].count += invec[i].count;
+    }
+}
+
+static void reduce_histogram(struct histogram *invec,
+                             struct histogram *inoutvec,
+                             int *len, MPI_Datatype *dtype)
+{
+    for (int i = 0; i < *len; i++)
+    {
+        inoutvec[i].count += invec[i].count;
+        inoutvec[i].max    = MAX(invec[i].max, inoutvec[i].max);
+        for (int b = 0; b < HIST_NBUCKETS; b++)
+            inoutvec[i].buckets[b] += invec[i].buckets[b];
+    }
+}
+
+static void init_mpi(int argc, char *argv[], const int nservers)
+{
+    MPI_CHECK(MPI_Init(&argc, &argv));
+
+    MPI_CHECK(MPI_Type_contiguous(sizeof(struct results_reduced) /
+                                  sizeof(double), MPI_DOUBLE,
+                                  &reduced_dtype));
+    MPI_CHECK(MPI_Type_commit(&reduced_dtype));
+    MPI_CHECK(MPI_Op_create((MPI_User_function *) reduce_results, 1,
+                            &reduced_op));
+
+    MPI_CHECK(MPI_Type_contiguous(sizeof(struct histogram) / sizeof(uint64_t),
+                                  MPI_UINT64_T, &hist_dtype));
+    MPI_CHECK(MPI_Type_commit(&hist_dtype));
+    MPI_CHECK(MPI_Op_create((MPI_User_function *) reduce_histogram, 1,
+                            &hist_op));
+
+    MPI_CHECK(MPI_Comm_rank(MPI_COMM_WORLD, &my.glob_rank));
+    MPI_CHECK(MPI_Comm_size(MPI_COMM_WORLD, &my.glob_size));
+
+    MPI_Group clients_group;
+    MPI_Group world_group;
+
+    MPI_CHECK(MPI_Comm_group(MPI_COMM_WORLD, &world_group));
+    int clients_range[1][3] = {{nservers, my.glob_size - 1, 1}};
+    MPI_CHECK(MPI_Group_range_incl(world_group, 1, clients_range,
+                                   &clients_group));
+
+    MPI_CHECK(MPI_Comm_create_group(MPI_COMM_WORLD, clients_group, 0,
+                                    &clients_comm));
+    MPI_CHECK(MPI_Group_free(&clients_group));
+    MPI_CHECK(MPI_Group_free(&world_group));
+}
+
+static void destroy_mpi(void)
+{
+    if (clients_comm != MPI_COMM_NULL)
+    {
+        MPI_CHECK(MPI_Comm_free(&clients_comm));
+        clients_comm = MPI_COMM_NULL;
+    }
+
+    if (my.clock_sync)
+        MPI_CHECK(MPI_Comm_free(&clock_state.comm));
+
+    MPI_CHECK(MPI_Op_free(&reduced_op));
+    MPI_CHECK(MPI_Type_free(&reduced_dtype));
+    MPI_CHECK(MPI_Op_free(&hist_op));
+    MPI_CHECK(MPI_Type_free(&hist_dtype));
+    MPI_CHECK(MPI_Finalize());
+}
+
+static void print_header_reduced(FILE *stream)
+{
+    int split_comm_rank;
+
+    /* Not part of client communicator: return */
+    if (clients_comm == MPI_COMM_NULL)
+        return;
+
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &split_comm_rank));
+    if (split_comm_rank != MPI_ROOT_RANK)
+        return;
+
+    fprintf(stream, "                                  SUM                                     MIN                                      MAX                                     LATENCY PERCENTILES          \n");
+    fprintf(stream, CONFIG_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    HIST_PRINT_HEADER"\n");
+}
+
+/* Machine-readable results: the root of the clients writes every record of
+ * the run to the results file, either one JSON object per line or one CSV
+ * row, with the same fields. The configuration and the hosts come first, as
+ * JSON objects or '#' lines in CSV. With a baseline, the results of a
+ * previous run are loaded first, and every record of this run is compared
+ * with the one of the same key as soon as it is produced */
+#define RECORD_NAME_SIZE 64
+
+/* Per-size aggregate (size), flow or (client, server) pair (pair), or node
+ * (node). The units are in the names of the fields */
+struct result_record
+{
+    char type[RECORD_NAME_SIZE];
+    char table[RECORD_NAME_SIZE]; /* all-to-all, intra-node, client-server */
+    char dir[RECORD_NAME_SIZE];
+    uint64_t size;
+    char src[RECORD_NAME_SIZE];   /* Source of a pair, name of a node */
+    char dst[RECORD_NAME_SIZE];
+    double count;                 /* Ranks, operations or flows */
+    double time_s;
+    double bw_mbs;
+    double bw_min_mbs;
+    double bw_max_mbs;
+    double lat_us;
+    double lat_min_us;
+    double lat_max_us;
+    double iops;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double p999_us;
+    double max_us;
+};
+
+enum record_kind
+{
+    RECORD_STR = 0,
+    RECORD_U64,
+    RECORD_DOUBLE,
+};
+
+static const struct record_field
+{
+    const char *name;
+    enum record_kind kind;
+    size_t offset;
+} record_fields[] = {
+#define RECORD_FIELD(field, kind)                                              \
+    { #field, kind, offsetof(struct result_record, field) }
+    RECORD_FIELD(type,       RECORD_STR),
+    RECORD_FIELD(table,      RECORD_STR),
+    RECORD_FIELD(dir,        RECORD_STR),
+    RECORD_FIELD(size,       RECORD_U64),
+    RECORD_FIELD(src,        RECORD_STR),
+    RECORD_FIELD(dst,        RECORD_STR),
+    RECORD_FIELD(count,      RECORD_DOUBLE),
+    RECORD_FIELD(time_s,     RECORD_DOUBLE),
+    RECORD_FIELD(bw_mbs,     RECORD_DOUBLE),
+    RECORD_FIELD(bw_min_mbs, RECORD_DOUBLE),
+    RECORD_FIELD(bw_max_mbs, RECORD_DOUBLE),
+    RECORD_FIELD(lat_us,     RECORD_DOUBLE),
+    RECORD_FIELD(lat_min_us, RECORD_DOUBLE),
+    RECORD_FIELD(lat_max_us, RECORD_DOUBLE),
+    RECORD_FIELD(iops,       RECORD_DOUBLE),
+    RECORD_FIELD(p50_us,     RECORD_DOUBLE),
+    RECORD_FIELD(p90_us,     RECORD_DOUBLE),
+    RECORD_FIELD(p99_us,     RECORD_DOUBLE),
+    RECORD_FIELD(p999_us,    RECORD_DOUBLE),
+    RECORD_FIELD(max_us,     RECORD_DOUBLE),
+#undef RECORD_FIELD
+};
+#define RECORD_NFIELDS (sizeof(record_fields) / sizeof(record_fields[0]))
+
+static struct
+{
+    FILE *stream;                  /* Results file, root of the clients */
+    struct result_record *baseline; /* Sorted by key */
+    bool *matched;                 /* Baseline records seen in this run */
+    size_t nbaseline;
+    int ncompared;
+    int nregressions;
+    bool incomplete;               /* Nothing compared, or baseline not run */
+    FILE *regressions;             /* One line per regression */
+    char *regressions_text;
+    size_t regressions_size;
+} results_state;
+
+static void record_write(FILE *stream, const struct result_record *rec)
+{
+    const bool json = my.results_format == RESULTS_FORMAT_JSON;
+
+    for (size_t f = 0; f < RECORD_NFIELDS; f++)
+    {
+        const struct record_field *field = &record_fields[f];
+        const void *value = (const char *) rec + field->offset;
+        const char *sep = f == 0 ? (json ? "{" : "") : ",";
+
+        /* Empty strings are left out of the JSON objects */
+        if (json && field->kind == RECORD_STR && *(const char *) value == 0)
+            continue;
+        if (json)
+            fprintf(stream, "%s\"%s\":", sep, field->name);
+        else
+            fputs(sep, stream);
+
+        switch (field->kind)
+        {
+        case RECORD_STR:
+            fprintf(stream, json ? "\"%s\"" : "%s", (const char *) value);
+            break;
+        case RECORD_U64:
+            fprintf(stream, "%"PRIu64, *(const uint64_t *) value);
+            break;
+        case RECORD_DOUBLE:
+            fprintf(stream, "%.6g", *(const double *) value);
+            break;
+        }
+    }
+    fputs(json ? "}\n" : "\n", stream);
+}
+
+/* Set the field 'name' of a record from its text, unknown fields are
+ * ignored */
+static void record_set(struct result_record *rec, const char *name,
+                       size_t name_len, const char *value, size_t value_len)
+{
+    for (size_t f = 0; f < RECORD_NFIELDS; f++)
+    {
+        const struct record_field *field = &record_fields[f];
+        void *ptr = (char *) rec + field->offset;
+
+        if (strlen(field->name) != name_len ||
+            strncmp(field->name, name, name_len) != 0)
+            continue;
+
+        switch (field->kind)
+        {
+        case RECORD_STR:
+            snprintf(ptr, RECORD_NAME_SIZE, "%.*s", (int) value_len, value);
+            break;
+        case RECORD_U64:
+            *(uint64_t *) ptr = strtoull(value, NULL, 10);
+            break;
+        case RECORD_DOUBLE:
+            *(double *) ptr = strtod(value, NULL);
+            break;
+        }
+        return;
+    }
+}
+
+/* Parse a flat JSON object, as written by record_write() */
+static void record_parse_json(struct result_record *rec, const char *line)
+{
+    const char *p = line;
+
+    while ((p = strchr(p, '"')) != NULL)
+    {
+        const char *name = ++p;
+        const char *value;
+        size_t name_len, value_len;
+
+        p = strchr(p, '"');
+        if (p == NULL)
+            return;
+        name_len = p - name;
+
+        p = strchr(p, ':');
+        if (p == NULL)
+            return;
+        p++;
+        if (*p == '"')
+        {
+            value = ++p;
+            p = strchr(p, '"');
+            if (p == NULL)
+                return;
+            value_len = p++ - value;
+        }
+        else
+        {
+            value = p;
+            value_len = strcspn(p, ",}");
+            p += value_len;
+        }
+        record_set(rec, name, name_len, value, value_len);
+    }
+}
+
+/* Parse a CSV row, whose columns are named by 'header' */
+static void record_parse_csv(struct result_record *rec, const char *header,
+                             const char *line)
+{
+    while (*header && *line)
+    {
+        const size_t name_len = strcspn(header, ",\n");
+        const size_t value_len = strcspn(line, ",\n");
+
+        record_set(rec, header, name_len, line, value_len);
+        /* Skip the comma, or the end of the line */
+        header += name_len + (header[name_len] != '\0');
+        line += value_len + (line[value_len] != '\0');
+    }
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+    const struct result_record *ra = a;
+    const struct result_record *rb = b;
+    int cmp;
+
+    if ((cmp = strcmp(ra->type, rb->type)) != 0 ||
+        (cmp = strcmp(ra->table, rb->table)) != 0 ||
+        (cmp = strcmp(ra->dir, rb->dir)) != 0)
+        return cmp;
+    if (ra->size != rb->size)
+        return ra->size < rb->size ? -1 : 1;
+    if ((cmp = strcmp(ra->src, rb->src)) != 0)
+        return cmp;
+    return strcmp(ra->dst, rb->dst);
+}
+
+/* Load the size, pair and node records of a results file, in either format.
+ * Returns false if it can not be read */
+static bool load_baseline(const char *path)
+{
+    FILE *stream = fopen(path, "r");
+    char *line = NULL, *header = NULL;
+    size_t line_size = 0, capacity = 0;
+
+    if (stream == NULL)
+        return false;
+
+    while (getline(&line, &line_size, stream) > 0)
+    {
+        struct result_record rec;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (line[0] != '{' && header == NULL)
+        {
+            header = strdup(line);
+            assert(header);
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        if (line[0] == '{')
+            record_parse_json(&rec, line);
+        else
+            record_parse_csv(&rec, header, line);
+        if (strcmp(rec.type, "size") != 0 && strcmp(rec.type, "pair") != 0 &&
+            strcmp(rec.type, "node") != 0)
+            continue;
+
+        if (results_state.nbaseline == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            results_state.baseline = realloc(results_state.baseline,
+                                             sizeof(rec) * capacity);
+            assert(results_state.baseline);
+        }
+        results_state.baseline[results_state.nbaseline++] = rec;
+    }
+
+    free(line);
+    free(header);
+    fclose(stream);
+
+    qsort(results_state.baseline, results_state.nbaseline,
+          sizeof(struct result_record), record_cmp);
+    results_state.matched = calloc(results_state.nbaseline + 1, sizeof(bool));
+    assert(results_state.matched);
+    results_state.regressions =
+        open_memstream(&results_state.regressions_text,
+                       &results_state.regressions_size);
+    assert(results_state.regressions);
+    return true;
+}
+
+/* Compare a metric with the baseline. 'higher' is true when a higher value
+ * is better */
+static void compare_metric(const struct result_record *rec, const char *name,
+                           double value, double base, bool higher,
+                           const char *unit)
+{
+    const double delta = (value - base) / base * 100;
+    FILE *stream = results_state.regressions;
+
+    if (base <= 0 || value <= 0 ||
+        (higher ? -delta : delta) <= my.tolerance)
+        return;
+
+    results_state.nregressions++;
+    fprintf(stream, "#   %s %s %s %"PRIu64, rec->type, rec->table, rec->dir,
+            rec->size);
+    if (rec->dst[0])
+        fprintf(stream, " %s -> %s", rec->src, rec->dst);
+    else if (rec->src[0])
+        fprintf(stream, " %s", rec->src);
+    fprintf(stream, ": %s %.2f -> %.2f %s (%+.1f%%)\n", name, base, value,
+            unit, delta);
+}
+
+/* Write a record of the current run, and compare it with the baseline */
+static void results_record(const struct result_record *rec)
+{
+    const struct result_record *base;
+
+    if (results_state.stream)
+        record_write(results_state.stream, rec);
+    if (results_state.baseline == NULL)
+        return;
+
+    base = bsearch(rec, results_state.baseline, results_state.nbaseline,
+                   sizeof(struct result_record), record_cmp);
+    if (base == NULL)
+        return;
+
+    results_state.matched[base - results_state.baseline] = true;
+    results_state.ncompared++;
+    compare_metric(rec, "bw", rec->bw_mbs, base->bw_mbs, true, "MB/s");
+    compare_metric(rec, "lat", rec->lat_us, base->lat_us, false, "us");
+}
+
+static inline bool results_enabled(void)
+{
+    return my.results_path || my.baseline_path;
+}
+
+/* Name of the node of a rank, i.e. its hostname without the rank that
+ * exchange_hostnames() appends */
+static void node_name(int rank, char *name)
+{
+    snprintf(name, RECORD_NAME_SIZE, "%s", my.nodes[my.node_ids[rank]]);
+}
+
+/* The reductions of the results of a size are not waited for: they run
+ * while the next size does, and are printed once its own results are ready,
+ * so that the sizes do not wait for each other. Up to REDUCED_MAX_PENDING
+ * lines can be in flight, every size having up to 3 directions x 3 rows
+ * (bidirectional) x 2 link classes */
+#define REDUCED_MAX_PENDING 18
+
+static struct reduced_line
+{
+    struct test_config config;  /* Direction and size of the line */
+    const char *table;          /* Of the records of the results file */
+    FILE *stream;
+    bool has_hist;
+    struct results_reduced res;
+    struct results_reduced res_out;
+    struct histogram hist;
+    struct histogram hist_out;
+    MPI_Request reqs[2];
+} reduced_lines[REDUCED_MAX_PENDING];
+static int reduced_npending;
+
+static void record_line(const struct reduced_line *line)
+{
+    const struct results_reduced *res = &line->res_out;
+    struct result_record rec = { .type = "size" };
+
+    snprintf(rec.table, sizeof(rec.table), "%s", line->table);
+    snprintf(rec.dir, sizeof(rec.dir), "%s",
+             direction_str[line->config.direction]);
+    rec.size = line->config.data_size;
+    rec.count = res->count;
+    rec.time_s = res->max.exec_time;
+    rec.bw_mbs = res->sum.bw;
+    rec.bw_min_mbs = res->min.bw;
+    rec.bw_max_mbs = res->max.bw;
+    rec.lat_us = res->count ? res->sum.latency / res->count : 0;
+    rec.lat_min_us = res->min.latency;
+    rec.lat_max_us = res->max.latency;
+    rec.iops = res->sum.iops;
+    if (line->has_hist)
+    {
+        rec.p50_us = hist_percentile(&line->hist_out, 0.50);
+        rec.p90_us = hist_percentile(&line->hist_out, 0.90);
+        rec.p99_us = hist_percentile(&line->hist_out, 0.99);
+        rec.p999_us = hist_percentile(&line->hist_out, 0.999);
+        rec.max_us = (double) line->hist_out.max / 1e3;
+    }
+    results_record(&rec);
+}
+
+/* Wait for the lines in flight and print them, in order */
+static void flush_results_reduced(void)
+{
+    int split_comm_rank;
+
+    if (reduced_npending == 0)
+        return;
+
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &split_comm_rank));
+    for (int l = 0; l < reduced_npending; l++)
+    {
+        struct reduced_line *line = &reduced_lines[l];
+
+        MPI_CHECK(MPI_Waitall(2, line->reqs, MPI_STATUSES_IGNORE));
+        if (split_comm_rank != MPI_ROOT_RANK)
+            continue;
+
+        if (results_enabled())
+            record_line(line);
+
+        fprintf(line->stream, CONFIG_PRINT_FMT" "
+                              RESULTS_PRINT_FMT" "
+                              RESULTS_PRINT_FMT" "
+                              RESULTS_PRINT_FMT,
+                              CONFIG_PRINT_ARGS(&line->config),
+                              RESULTS_PRINT_ARGS(&line->res_out.sum),
+                              RESULTS_PRINT_ARGS(&line->res_out.min),
+                              RESULTS_PRINT_ARGS(&line->res_out.max));
+        if (line->has_hist)
+            fprintf(line->stream, " "HIST_PRINT_FMT,
+                    HIST_PRINT_ARGS(&line->hist_out));
+        fprintf(line->stream, "\n");
+    }
+    reduced_npending = 0;
+}
+
+/* Reduce and print the results of all the clients, with a single reduction
+ * for SUM, MIN and MAX. The lines of the previous size are printed first.
+ * The latency percentiles are only printed if a histogram is given */
+static void print_results_reduced(const struct test_config *config,
+                                  const struct results *input_res,
+                                  const struct histogram *input_hist,
+                                  const char *table, FILE *stream)
+{
+    struct reduced_line *line;
+
+    /* Not part of client communicator: return */
+    if (clients_comm == MPI_COMM_NULL)
+        return;
+
+    if (reduced_npending == REDUCED_MAX_PENDING ||
+        (reduced_npending > 0 &&
+         reduced_lines[0].config.curr_iter != config->curr_iter))
+        flush_results_reduced();
+
+    /* The inputs are copied, the next size reuses them meanwhile */
+    line = &reduced_lines[reduced_npending++];
+    line->config = *config;
+    line->table = table;
+    line->stream = stream;
+    line->has_hist = input_hist != NULL;
+    results_reduced_init(input_res, &line->res);
+    MPI_CHECK(MPI_Ireduce(&line->res, &line->res_out, 1, reduced_dtype,
+                          reduced_op, MPI_ROOT_RANK, clients_comm,
+                          &line->reqs[0]));
+    line->reqs[1] = MPI_REQUEST_NULL;
+    if (input_hist)
+    {
+        line->hist = *input_hist;
+        MPI_CHECK(MPI_Ireduce(&line->hist, &line->hist_out, 1, hist_dtype,
+                              hist_op, MPI_ROOT_RANK, clients_comm,
+                              &line->reqs[1]));
+    }
+}
+
+/* Report the corrupted messages of the current size, per link. Every rank
+ * counts the messages it received, which gives the destination of the
+ * links. The root of the clients prints them, right below the results */
+static void report_verify(const struct test_config *config, FILE *stream)
+{
+    const int root = my.nservers;
+    const struct verify_stats *stats = config->verify;
+    uint64_t local[2] = { stats->checked, 0 };
+    uint64_t total[2];
+    uint64_t *links, *all_links = NULL;
+    int *counts = NULL, *displs = NULL;
+    int nlinks = 0, nvalues, total_values = 0;
+
+    /* Right below the results of the size */
+    flush_results_reduced();
+
+    for (int r = 0; r < my.glob_size; r++)
+    {
+        if (stats->errors[r] == 0)
+            continue;
+        local[1] += stats->errors[r];
+        nlinks++;
+    }
+
+    MPI_CHECK(MPI_Allreduce(local, total, 2, MPI_UINT64_T, MPI_SUM,
+                            MPI_COMM_WORLD));
+    my.verified += total[0];
+    my.corrupted += total[1];
+    if (total[1] == 0)
+        return;
+
+    /* (source, destination, count) of every corrupted link */
+    nvalues = nlinks * 3;
+    links = malloc(sizeof(uint64_t) * (nvalues + 1));
+    assert(links);
+    for (int r = 0, i = 0; r < my.glob_size; r++)
+    {
+        if (stats->errors[r] == 0)
+            continue;
+        links[i++] = r;
+        links[i++] = my.glob_rank;
+        links[i++] = stats->errors[r];
+    }
+
+    if (my.glob_rank == root)
+    {
+        counts = malloc(sizeof(int) * my.glob_size);
+        displs = malloc(sizeof(int) * my.glob_size);
+        assert(counts && displs);
+    }
+
+    MPI_CHECK(MPI_Gather(&nvalues, 1, MPI_INT, counts, 1, MPI_INT, root,
+                         MPI_COMM_WORLD));
+    if (my.glob_rank == root)
+    {
+        for (int r = 0; r < my.glob_size; r++)
+        {
+            displs[r] = total_values;
+            total_values += counts[r];
+        }
+        all_links = malloc(sizeof(uint64_t) * total_values);
+        assert(all_links);
+    }
+
+    MPI_CHECK(MPI_Gatherv(links, nvalues, MPI_UINT64_T,
+                          all_links, counts, displs, MPI_UINT64_T,
+                          root, MPI_COMM_WORLD));
+
+    if (my.glob_rank == root)
+    {
+        fprintf(stream, "# Integrity "CONFIG_PRINT_FMT": %"PRIu64
+                        " corrupted messages out of %"PRIu64"\n",
+                CONFIG_PRINT_ARGS(config), total[1], total[0]);
+        for (int i = 0; i < total_values; i += 3)
+            fprintf(stream, "#   %s -> %s: %"PRIu64"\n",
+                    get_hostname(all_links[i], false),
+                    get_hostname(all_links[i + 1], false),
+                    all_links[i + 2]);
+    }
+
+    free(links);
+    free(all_links);
+    free(counts);
+    free(displs);
+}
+
+/* One direction of a link is this many times slower than the other one, and
+ * by at least ASYM_MIN_DIFF seconds */
+#define ASYM_MIN_RATIO 2.0
+#define ASYM_MIN_DIFF  10e-6
+
+/* Report the spread of the global times the clients started and finished
+ * the current size at, the one-way latencies, and in all-to-all mode the
+ * links whose directions differ the most, which hints at asymmetric routes */
+static void report_clock(const struct test_config *config, FILE *stream)
+{
+    const struct one_way_stats *stats = config->one_way;
+    static struct histogram hist;
+    const double local[2] = { stats->start, stats->end };
+    double min[2], max[2];
+    float *means, *all_means = NULL;
+    int client_rank, nclients;
+    int nasym = 0;
+
+    /* Right below the results of the size */
+    flush_results_reduced();
+
+    /* Not part of client communicator: return */
+    if (clients_comm == MPI_COMM_NULL)
+        return;
+
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &client_rank));
+    MPI_CHECK(MPI_Comm_size(clients_comm, &nclients));
+    MPI_CHECK(MPI_Reduce(local, min, 2, MPI_DOUBLE, MPI_MIN, MPI_ROOT_RANK,
+                         clients_comm));
+    MPI_CHECK(MPI_Reduce(local, max, 2, MPI_DOUBLE, MPI_MAX, MPI_ROOT_RANK,
+                         clients_comm));
+    MPI_CHECK(MPI_Reduce(&stats->hist, &hist, 1, hist_dtype, hist_op,
+                         MPI_ROOT_RANK, clients_comm));
+
+    if (client_rank == MPI_ROOT_RANK)
+    {
+        fprintf(stream, "# Clock "CONFIG_PRINT_FMT": start spread %.2f us, "
+                        "finish spread %.2f us",
+                CONFIG_PRINT_ARGS(config),
+                (max[0] - min[0]) * 1e6, (max[1] - min[1]) * 1e6);
+        if (hist.count)
+            fprintf(stream, ", one-way p50 %.2f p99 %.2f max %.2f us",
+                    hist_percentile(&hist, 0.50),
+                    hist_percentile(&hist, 0.99),
+                    (double) hist.max / 1e3);
+        fprintf(stream, "\n");
+    }
+
+    /* Only the two-sided all-to-all messages are stamped, where all the
+     * ranks are clients */
+    if (config->test_mode != TEST_MODE_ALL_TO_ALL ||
+        config->direction != DIR_NONE)
+        return;
+
+    means = malloc(sizeof(float) * nclients);
+    assert(means);
+    for (int src = 0; src < nclients; src++)
+        means[src] = stats->count[src] ?
+                     stats->sum[src] / stats->count[src] : 0;
+
+    if (client_rank == MPI_ROOT_RANK)
+    {
+        all_means = malloc(sizeof(float) * nclients * nclients);
+        assert(all_means);
+    }
+
+    MPI_CHECK(MPI_Gather(means, nclients, MPI_FLOAT,
+                         all_means, nclients, MPI_FLOAT,
+                         MPI_ROOT_RANK, clients_comm));
+
+    for (int a = 0; all_means && a < nclients; a++)
+    {
+        for (int b = a + 1; b < nclients; b++)
+        {
+            /* Flows are measured by their destination */
+            const float ab = all_means[(size_t) b * nclients + a];
+            const float ba = all_means[(size_t) a * nclients + b];
+            const float lo = MIN(ab, ba), hi = MAX(ab, ba);
+
+            if (lo <= 0 || hi < lo * ASYM_MIN_RATIO ||
+                hi - lo < ASYM_MIN_DIFF)
+                continue;
+
+            if (nasym++ == 0)
+                fprintf(stream, "# Asymmetric links "CONFIG_PRINT_FMT
+                                " (mean one-way latency)\n",
+                        CONFIG_PRINT_ARGS(config));
+            fprintf(stream, "#   %s -> %s: %.2f us, %s -> %s: %.2f us\n",
+                    get_hostname(a, true), get_hostname(b, true), ab * 1e6,
+                    get_hostname(b, true), get_hostname(a, true), ba * 1e6);
+        }
+    }
+
+    free(means);
+    free(all_means);
+}
+
+/* A flow, or all the flows of a rank in one direction, is an outlier when
+ * its bandwidth is below the median by more than OUTLIER_NMADS times the
+ * (normalized) MAD, and by more than OUTLIER_MIN_DROP of the median. The
+ * latter keeps a very homogeneous fabric from reporting noise */
+#define OUTLIER_NMADS    3.0
+#define OUTLIER_MIN_DROP 0.10
+#define MAD_NORMAL_SCALE 1.4826
+
+static int compare_float(const void *a, const void *b)
+{
+    const float fa = *(const float *) a;
+    const float fb = *(const float *) b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+/* Median of the first 'count' values, which get sorted */
+static float median(float *values, int count)
+{
+    if (count == 0)
+        return 0;
+
+    qsort(values, count, sizeof(float), compare_float);
+    if (count % 2)
+        return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+static bool is_outlier(float bw, float med, float mad)
+{
+    return med - bw > MAX(OUTLIER_NMADS * mad, OUTLIER_MIN_DROP * med);
+}
+
+/* Median and normalized MAD of the first 'count' values, which get
+ * overwritten */
+static void median_mad(float *values, int count, float *med, float *mad)
+{
+    *med = median(values, count);
+    for (int i = 0; i < count; i++)
+        values[i] = fabsf(values[i] - *med);
+    *mad = MAD_NORMAL_SCALE * median(values, count);
+}
+
+#define PAIRS_PRINT_HEADER                                                     \
+    "#           client           server        ops   size(MB) bw(MB/s) "      \
+    "rpc(us) rpc-max(us) service(us) svc-max(us)"
+
+#define PAIRS_PRINT_FMT                                                        \
+    "# %16s %16s %10.0f %10.1f %8.1f %7.2f %11.2f %11.2f %11.2f\n"
+
+static void print_pairs(const struct test_config *config,
+                        const struct pair_stats *rpc,
+                        const struct pair_stats *svc, FILE *stream)
+{
+    fprintf(stream, "# Pairs "CONFIG_PRINT_FMT" (RPCs timed by the client, "
+                    "service timed by the server)\n",
+            CONFIG_PRINT_ARGS(config));
+    fprintf(stream, PAIRS_PRINT_HEADER"\n");
+
+    for (int c = 0; c < my.nclients; c++)
+    {
+        for (int s = 0; s < my.nservers; s++)
+        {
+            const struct pair_stats *r = &rpc[(size_t) c * my.nservers + s];
+            const struct pair_stats *v = &svc[(size_t) s * my.nclients + c];
+            struct results res;
+
+            generate_results_pair(r, 0, &res);
+            fprintf(stream, PAIRS_PRINT_FMT,
+                    get_hostname(c, true), get_hostname(s, false),
+                    r->ops, r->bytes / (1024 * 1024), res.bw, res.latency,
+                    r->max_time * 1e6,
+                    v->ops ? v->time / v->ops * 1e6 : 0, v->max_time * 1e6);
+        }
+    }
+}
+
+/* Every (client, server) pair, as timed by the client */
+static void record_pairs(const struct test_config *config,
+                         const struct pair_stats *rpc)
+{
+    struct result_record rec = {
+        .type = "pair", .table = "client-server",
+    };
+
+    snprintf(rec.dir, sizeof(rec.dir), "%s",
+             direction_str[config->direction]);
+    rec.size = config->data_size;
+
+    for (int c = 0; c < my.nclients; c++)
+    {
+        for (int s = 0; s < my.nservers; s++)
+        {
+            const struct pair_stats *r = &rpc[(size_t) c * my.nservers + s];
+            struct results res;
+
+            generate_results_pair(r, 0, &res);
+            snprintf(rec.src, sizeof(rec.src), "%s", get_hostname(c, true));
+            snprintf(rec.dst, sizeof(rec.dst), "%s", get_hostname(s, false));
+            rec.count = r->ops;
+            rec.bw_mbs = res.bw;
+            rec.lat_us = res.latency;
+            rec.lat_max_us = r->max_time * 1e6;
+            results_record(&rec);
+        }
+    }
+}
+
+/* Flag the outliers among the medians of the servers or the clients */
+static void flag_slow(const float *meds, int count, float *values,
+                      bool *slow, float *all)
+{
+    float mad;
+
+    memcpy(values, meds, sizeof(float) * count);
+    median_mad(values, count, all, &mad);
+    for (int i = 0; i < count; i++)
+        slow[i] = count >= 3 && is_outlier(meds[i], *all, mad);
+}
+
+/* Look for slow servers, clients and pairs from the bandwidth of every
+ * pair, the same way as analyze_matrix() does for the all-to-all ranks and
+ * links: a server port or a client HCA is slow when the median of its pairs
+ * is an outlier among the servers or the clients, a pair when its bandwidth
+ * is an outlier among all the pairs while neither of its ends is slow */
+static void analyze_pairs(const struct test_config *config,
+                          const struct pair_stats *rpc, FILE *stream)
+{
+    const int nservers = my.nservers, nclients = my.nclients;
+    const int npairs = nservers * nclients;
+    float *bw = malloc(sizeof(float) * npairs);
+    float *values = malloc(sizeof(float) * npairs);
+    float *server_med = malloc(sizeof(float) * nservers);
+    float *client_med = malloc(sizeof(float) * nclients);
+    bool *slow_server = malloc(sizeof(bool) * nservers);
+    bool *slow_client = malloc(sizeof(bool) * nclients);
+    float med, mad, server_all, client_all;
+    int noutliers = 0;
+
+    assert(bw && values && server_med && client_med &&
+           slow_server && slow_client);
+
+    for (int i = 0; i < npairs; i++)
+    {
+        struct results res;
+
+        generate_results_pair(&rpc[i], 0, &res);
+        bw[i] = res.bw;
+    }
+
+    for (int s = 0; s < nservers; s++)
+    {
+        for (int c = 0; c < nclients; c++)
+            values[c] = bw[c * nservers + s];
+        server_med[s] = median(values, nclients);
+    }
+    for (int c = 0; c < nclients; c++)
+    {
+        memcpy(values, &bw[c * nservers], sizeof(float) * nservers);
+        client_med[c] = median(values, nservers);
+    }
+    flag_slow(server_med, nservers, values, slow_server, &server_all);
+    flag_slow(client_med, nclients, values, slow_client, &client_all);
+
+    memcpy(values, bw, sizeof(float) * npairs);
+    median_mad(values, npairs, &med, &mad);
+
+    fprintf(stream, "# Outliers "CONFIG_PRINT_FMT" (pair bandwidth below the "
+                    "median by more than %.1f MADs and %.0f%%)\n",
+            CONFIG_PRINT_ARGS(config), OUTLIER_NMADS, OUTLIER_MIN_DROP * 100);
+
+    for (int s = 0; s < nservers; s++)
+    {
+        if (!slow_server[s])
+            continue;
+        fprintf(stream, "#   slow server %s: %.0f MB/s (%+.0f%%)\n",
+                get_hostname(s, false), server_med[s],
+                100 * (server_med[s] - server_all) / server_all);
+        noutliers++;
+    }
+
+    for (int c = 0; c < nclients; c++)
+    {
+        if (!slow_client[c])
+            continue;
+        fprintf(stream, "#   slow client %s: %.0f MB/s (%+.0f%%)\n",
+                get_hostname(c, true), client_med[c],
+                100 * (client_med[c] - client_all) / client_all);
+        noutliers++;
+    }
+
+    for (int c = 0; npairs >= 3 && c < nclients; c++)
+    {
+        for (int s = 0; s < nservers; s++)
+        {
+            const float pair_bw = bw[c * nservers + s];
+
+            if (slow_client[c] || slow_server[s] ||
+                !is_outlier(pair_bw, med, mad))
+                continue;
+            fprintf(stream, "#   slow pair %s -> %s: %.0f MB/s (%+.0f%%)\n",
+                    get_hostname(c, true), get_hostname(s, false),
+                    pair_bw, 100 * (pair_bw - med) / med);
+            noutliers++;
+        }
+    }
+
+    if (noutliers == 0)
+        fprintf(stream, "#   None\n");
+
+    free(bw);
+    free(values);
+    free(server_med);
+    free(client_med);
+    free(slow_server);
+    free(slow_client);
+}
+
+/* Report the RPCs of the current size per (client, server) pair. Every rank
+ * sends the counters of its peers to the root of the clients, servers first,
+ * so that one slow server port or one bad client HCA can be singled out,
+ * while they only drag the aggregate down */
+static void report_pairs(const struct test_config *config, FILE *stream)
+{
+    const int root = my.nservers;
+    const int npeers = is_server() ? my.nclients : my.nservers;
+    const size_t npairs = (size_t) my.nservers * my.nclients;
+    struct pair_stats *all = NULL;
+    int *counts = NULL, *displs = NULL;
+
+    /* Right below the results of the size */
+    flush_results_reduced();
+
+    if (my.glob_rank == root)
+    {
+        all = malloc(sizeof(struct pair_stats) * npairs * 2);
+        counts = malloc(sizeof(int) * my.glob_size);
+        displs = malloc(sizeof(int) * my.glob_size);
+        assert(all && counts && displs);
+
+        for (int r = 0, displ = 0; r < my.glob_size; r++)
+        {
+            counts[r] = (r < my.nservers ? my.nclients : my.nservers) *
+                        PAIR_STATS_NVALUES;
+            displs[r] = displ;
+            displ += counts[r];
+        }
+    }
+
+    MPI_CHECK(MPI_Gatherv(config->pairs, npeers * PAIR_STATS_NVALUES,
+                          MPI_DOUBLE, all, counts, displs, MPI_DOUBLE,
+                          root, MPI_COMM_WORLD));
+
+    if (my.glob_rank == root)
+    {
+        /* Server x client counters, then client x server ones */
+        const struct pair_stats *svc = all;
+        const struct pair_stats *rpc = all + npairs;
+
+        if (my.pairs)
+            print_pairs(config, rpc, svc, stream);
+        if (my.analyze)
+            analyze_pairs(config, rpc, stream);
+        if (results_enabled())
+            record_pairs(config, rpc);
+    }
+
+    free(all);
+    free(counts);
+    free(displs);
+}
+
+/* Upper bound of the number of sizes of a sweep */
+#define MAX_SIZES 4096
+
+/* Parse a size in bytes, with an optional K, M, G or T (binary) suffix.
+ * 'spec' is the whole option, for the error message */
+static size_t parse_size(const char *str, const char *spec)
+{
+    char *end;
+    unsigned long long size;
+    int shift = 0;
+
+    errno = 0;
+    size = strtoull(str, &end, 0);
+
+    switch (*end)
+    {
+    case 'T': case 't': shift += 10; /* fallthrough */
+    case 'G': case 'g': shift += 10; /* fallthrough */
+    case 'M': case 'm': shift += 10; /* fallthrough */
+    case 'K': case 'k': shift += 10; end++; break;
+    default: break;
+    }
+
+    /* A size which does not fit once shifted would silently wrap */
+    if (end == str || (*end != '\0' && *end != ':' && *end != ',') ||
+        errno == ERANGE || *str == '-' || size > (SIZE_MAX >> shift))
+    {
+        fprintf(stderr, "Invalid size in %s\n", spec);
+        exit(EXIT_FAILURE);
+    }
+
+    size <<= shift;
+    if (size == 0 || size > SIZE_MAX / NUM_RDMA_BUFFERS)
+    {
+        fprintf(stderr, "Invalid size in %s\n", spec);
+        exit(EXIT_FAILURE);
+    }
+
+    return size;
+}
+
+static void add_size(size_t size, const char *spec)
+{
+    if (my.nsizes >= MAX_SIZES)
+    {
+        fprintf(stderr, "Too many sizes in %s (max %d)\n", spec, MAX_SIZES);
+        exit(EXIT_FAILURE);
+    }
+
+    my.sizes[my.nsizes++] = size;
+}
+
+/* Build the sizes of the sweep from its specification:
+ * - <start>:<end>[:x<mult>], from start to end multiplied by mult (2 by
+ *   default) at each step,
+ * - <start>:<end>:+<step>, from start to end by steps of step bytes,
+ * - <size>[,<size>...], an explicit list, run in that order. */
+static void parse_sizes(const char *spec)
+{
+    const char *range = strchr(spec, ':');
+
+    free(my.sizes);
+    my.sizes = malloc(sizeof(*my.sizes) * MAX_SIZES);
+    assert(my.sizes);
+    my.nsizes = 0;
+
+    if (range == NULL)
+    {
+        for (const char *str = spec; str; str = strchr(str, ','))
+        {
+            if (*str == ',')
+                str++;
+            add_size(parse_size(str, spec), spec);
+        }
+        return;
+    }
+
+    const size_t start = parse_size(spec, spec);
+    const char *step_spec = strchr(range + 1, ':');
+    const size_t end = parse_size(range + 1, spec);
+    bool linear = false;
+    size_t step = 2;
+
+    if (step_spec)
+    {
+        linear = step_spec[1] == '+';
+        if (!linear && step_spec[1] != 'x')
+        {
+            fprintf(stderr, "Invalid step in %s, expected x<mult> or "
+                            "+<step>\n", spec);
+            exit(EXIT_FAILURE);
+        }
+        step = parse_size(step_spec + 2, spec);
+    }
+
+    if (start > end || (!linear && step < 2))
+    {
+        fprintf(stderr, "Invalid range in %s\n", spec);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t size = start; size <= end;)
+    {
+        add_size(size, spec);
+
+        /* Stop before wrapping around */
+        if (linear ? size > SIZE_MAX - step : size > SIZE_MAX / step)
+            break;
+        size = linear ? size + step : size * step;
+    }
+}
+
+/* Largest size of the sweep, which the buffers are allocated for */
+static size_t max_size(void)
+{
+    size_t max = 0;
+
+    for (int i = 0; i < my.nsizes; i++)
+        max = MAX(max, my.sizes[i]);
+    return max;
+}
+
+/* Longest host name out of a hostlist */
+#define HOSTLIST_NAME_SIZE 1024
+
+static void hostlist_error(const char *spec, const char *error)
+{
+    fprintf(stderr, "Invalid hostlist %s: %s\n", spec, error);
+    exit(EXIT_FAILURE);
+}
+
+/* Digits of a bound of a range, which the expanded numbers are padded to */
+static unsigned long hostlist_bound(const char *spec, const char *str,
+                                    const char **end, int *width)
+{
+    char *num_end;
+    unsigned long bound;
+
+    if (*str < '0' || *str > '9')
+        hostlist_error(spec, "expected a number in brackets");
+
+    errno = 0;
+    bound = strtoul(str, &num_end, 10);
+    if (errno)
+        hostlist_error(spec, "number out of range");
+
+    *width = num_end - str;
+    *end = num_end;
+    return bound;
+}
+
+/* Print the hosts of a word of a hostlist, from 'word' to 'end', after the
+ * 'host_len' characters of 'host' already expanded. The first bracket is
+ * expanded, each of its elements followed by the rest of the word, so that
+ * rack[1-2]-node[01-16] is 32 hosts */
+static void expand_word(FILE *stream, const char *spec, char *host,
+                        size_t host_len, const char *word, const char *end,
+                        int *nhosts)
+{
+    const char *open = word + strcspn(word, "[{");
+
+    if (open > end)
+        open = end;
+    if (host_len + (open - word) >= HOSTLIST_NAME_SIZE)
+        hostlist_error(spec, "host name too long");
+    memcpy(host + host_len, word, open - word);
+    host_len += open - word;
+
+    if (open == end)
+    {
+        host[host_len] = '\0';
+        fprintf(stream, "%s%s", *nhosts ? "," : "", host);
+        ++*nhosts;
+        return;
+    }
+
+    const bool list = *open == '{';
+    const char *close = memchr(open, list ? '}' : ']', end - open);
+
+    if (close == NULL)
+        hostlist_error(spec, "unbalanced brackets");
+
+    for (const char *elem = open + 1; elem <= close; elem++)
+    {
+        const char *elem_end = memchr(elem, ',', close - elem);
+
+        if (elem_end == NULL)
+            elem_end = close;
+
+        /* {a,b}: strings, [a-b,c]: numbers and ranges of numbers */
+        if (list)
+        {
+            if (elem_end == elem)
+                hostlist_error(spec, "invalid list in braces");
+            if (host_len + (elem_end - elem) >= HOSTLIST_NAME_SIZE)
+                hostlist_error(spec, "host name too long");
+            memcpy(host + host_len, elem, elem_end - elem);
+            expand_word(stream, spec, host, host_len + (elem_end - elem),
+                        close + 1, end, nhosts);
+        }
+        else
+        {
+            const char *num_end;
+            int width, upper_width;
+            unsigned long lower, upper;
+
+            lower = hostlist_bound(spec, elem, &num_end, &width);
+            upper = lower;
+            if (*num_end == '-')
+                upper = hostlist_bound(spec, num_end + 1, &num_end,
+                                       &upper_width);
+            if (num_end != elem_end || lower > upper)
+                hostlist_error(spec, "invalid range in brackets");
+
+            for (unsigned long i = lower; i <= upper; i++)
+            {
+                int len = snprintf(host + host_len,
+                                   HOSTLIST_NAME_SIZE - host_len,
+                                   "%0*lu", width, i);
+
+                if (host_len + len >= HOSTLIST_NAME_SIZE)
+                    hostlist_error(spec, "host name too long");
+                expand_word(stream, spec, host, host_len + len, close + 1,
+                            end, nhosts);
+                if (i == ULONG_MAX)
+                    break;
+            }
+        }
+        elem = elem_end;
+    }
+}
+
+/* Print the hosts of a hostlist, comma-separated. The words of the list are
+ * separated by commas or blanks, outside of the brackets:
+ * - node[1-3,10] is node1,node2,node3,node10, the numbers being padded to
+ *   the digits of the lower bound, node[01-10] being node01,...,node10,
+ * - node{a,b} is nodea,nodeb. */
+static void expand_hostlist(FILE *stream, const char *spec, int *nhosts)
+{
+    char host[HOSTLIST_NAME_SIZE];
+    const char *word = spec;
+    bool bracket = false;
+
+    for (const char *c = spec; ; c++)
+    {
+        if (*c == '[' || *c == '{')
+            bracket = true;
+        else if (*c == ']' || *c == '}')
+            bracket = false;
+        else if (*c == '\0' || (!bracket && strchr(", \t\r\n", *c)))
+        {
+            if (c > word)
+                expand_word(stream, spec, host, 0, word, c, nhosts);
+            word = c + 1;
+        }
+
+        if (*c == '\0')
+            break;
+    }
+}
+
+/* Print the hosts of a host file: the first word of every line is a
+ * hostlist, so that the hostfiles of mpirun (host slots=N) also work, and
+ * '#' starts a comment */
+static void expand_hostfile(FILE *stream, const char *path, int *nhosts)
+{
+    FILE *file = fopen(path, "r");
+    size_t line_size = 0;
+    char *line = NULL;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while (getline(&line, &line_size, file) > 0)
+    {
+        char *spec = line + strspn(line, " \t");
+
+        spec[strcspn(spec, " \t\r\n#")] = '\0';
+        if (*spec != '\0')
+            expand_hostlist(stream, spec, nhosts);
+    }
+
+    free(line);
+    fclose(file);
+}
+
+/* Print the hosts of --expand and --expand-file for the launcher, which
+ * needs them before MPI starts. The hosts are expanded in memory first, so
+ * that nothing is printed when a later part of the list is invalid */
+static int expand_hosts(FILE *stream)
+{
+    char *hosts = NULL;
+    size_t hosts_size = 0;
+    FILE *buffer = open_memstream(&hosts, &hosts_size);
+    int nhosts = 0;
+
+    assert(buffer);
+    if (my.expand)
+        expand_hostlist(buffer, my.expand, &nhosts);
+    if (my.expand_file)
+        expand_hostfile(buffer, my.expand_file, &nhosts);
+    fclose(buffer);
+
+    if (nhosts == 0)
+    {
+        fprintf(stderr, "No host to expand\n");
+        free(hosts);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stream, "%s\n", hosts);
+    free(hosts);
+    return EXIT_SUCCESS;
+}
+
+static void help_usage(char *prog, FILE *stream)
+{
+    fprintf(stream, "IME Network Analysis Tool.\n\n");
+    fprintf(stream, "Usage: %s [OPTIONS]\n", basename(prog));
+    fprintf(stream, "\t-s, --nservers\tNumber of servers.\n");
+    fprintf(stream, "\t-i, --niters\tNumber of iterations.\n");
+    fprintf(stream, "\t-f, --nflight\tNumber of max inflight messages per client.\n");
+    fprintf(stream, "\t-b, --bsize\tSize of network buffers to test (in bytes, K/M/G suffixes allowed).\n");
+    fprintf(stream, "\t-z, --sizes\tSizes to test: <start>:<end>[:x<mult>] (default: 1:4M:x2),\n"
+                    "\t\t\t<start>:<end>:+<step> or a list such as 1M,12M,8M.\n");
+    fprintf(stream, "\t-w, --batch\tWait for the whole nflight window before posting new RPCs (client/server).\n");
+    fprintf(stream, "\t-d, --bidirectional\tBoth peers send and receive at once in all-to-all mode.\n");
+    fprintf(stream, "\t-p, --pattern\tAll-to-all pattern: linktest (default), shift, random, bisection,\n"
+                    "\t\t\tincast, broadcast or neighbor.\n");
+    fprintf(stream, "\t-r, --seed\tSeed of the random pattern.\n");
+    fprintf(stream, "\t-L, --intra-node\tLinks between ranks of the same node in all-to-all mode:\n"
+                    "\t\t\tinclude (default), skip or separate (reported in their own table).\n");
+    fprintf(stream, "\t-M, --matrix\tWrite the all-to-all link-bandwidth matrix to <prefix>.bin.\n");
+    fprintf(stream, "\t-E, --matrix-export\tAlso export the matrix to <prefix>.csv or <prefix>.json: none (default), csv or json.\n");
+    fprintf(stream, "\t-A, --analyze\tLook for slow nodes and slow links in the all-to-all results,\n"
+                    "\t\t\tor slow servers, clients and pairs in client/server mode.\n");
+    fprintf(stream, "\t-T, --time-per-size\tRun each size for about this many seconds instead of a fixed number of iterations.\n");
+    fprintf(stream, "\t-D, --duration\tRun the whole sweep in about this many seconds, split evenly between the sizes.\n");
+    fprintf(stream, "\t-C, --ci\tWith a time budget, stop a size early once the 95%% confidence interval of its\n"
+                    "\t\t\tbandwidth is within this many percents (default: 1, 0 to always use the whole budget).\n");
+    fprintf(stream, "\t-P, --persistent\tUse persistent requests (MPI_Send_init/MPI_Recv_init + MPI_Startall) in the test loops.\n");
+    fprintf(stream, "\t-R, --rma\tAlso run each all-to-all size with one-sided MPI_Put and MPI_Get (Put/Get rows).\n");
+    fprintf(stream, "\t-m, --buffers\tMemory of the data buffers: malloc (default), huge2m, huge1g (hugepages)\n"
+                    "\t\t\tor mpi (MPI_Alloc_mem, usually pre-registered).\n");
+    fprintf(stream, "\t-N, --numa\tBind the data buffers to a NUMA node: none (default), auto (node of the HCA) or <node>.\n");
+    fprintf(stream, "\t-V, --verify\tCheck the payload of every message (seeded pattern and CRC32C),\n"
+                    "\t\t\tand report the corrupted messages per link.\n");
+    fprintf(stream, "\t-O, --monitor\tRepeat the all-to-all pattern with a single size for <sec> seconds,\n"
+                    "\t\t\treporting every interval.\n");
+    fprintf(stream, "\t-I, --interval\tSeconds between two monitoring reports (default: 60).\n");
+    fprintf(stream, "\t-W, --series\tWrite the per-link time series of the monitoring to a CSV file.\n");
+    fprintf(stream, "\t-Y, --clock-sync\tSynchronize the clocks to report one-way latencies, the start and\n"
+                    "\t\t\tfinish spread of the clients and asymmetric links.\n");
+    fprintf(stream, "\t-Q, --pairs\tReport the RPCs of every (client, server) pair in client/server mode.\n");
+    fprintf(stream, "\t-t, --sequential\tOnly one pair of ranks communicates at any time in all-to-all mode.\n");
+    fprintf(stream, "\t-G, --concurrent\tNumber of pairs communicating at once in sequential mode, each one in\n"
+                    "\t\t\tits own group of consecutive ranks (default: 1).\n");
+    fprintf(stream, "\t-X, --triage\tLocalize the bad ranks and links with a single size in a few coarse rounds,\n"
+                    "\t\t\tthen only test the suspects. Flows below <percent> of the median are slow.\n");
+    fprintf(stream, "\t-J, --results\tWrite the configuration, the hosts, the results of every size, the pairs\n"
+                    "\t\t\t(--pairs or --analyze) and the nodes (--matrix or --analyze) to a file, one record per line.\n");
+    fprintf(stream, "\t-F, --results-format\tFormat of the results file: json (JSON lines, default) or csv.\n");
+    fprintf(stream, "\t-U, --baseline\tCompare the results with a previous results file, and fail on regressions\n"
+                    "\t\t\tor when the run does not cover every record of the baseline.\n");
+    fprintf(stream, "\t-H, --tolerance\tPercents of bandwidth or latency regression allowed by --baseline (default: 10).\n");
+    fprintf(stream, "\t-c, --calibrate\tMeasure the overheads of the tool (timer, polling, 1-byte ping-pong, response\n"
+                    "\t\t\tof the windows, empty RPCs, barriers and reductions) before the results.\n");
+    fprintf(stream, "\t-x, --expand\tPrint the hosts of a hostlist (node[1-4,10], node[01-16], node{a,b}),\n"
+                    "\t\t\tcomma-separated, and exit without starting MPI (for the launchers).\n");
+    fprintf(stream, "\t-e, --expand-file\tSame as --expand, for a file with a hostlist per line ('#' comments).\n");
+    fprintf(stream, "\t-K, --fanout\tNumber of steps of the pattern run at once in all-to-all mode.\n");
+    fprintf(stream, "\t-S, --server-slots\tNumber of RPCs a server processes in parallel (default: %d).\n", NUM_RDMA_BUFFERS);
+    fprintf(stream, "\t-B, --server-blocking\tBlock in MPI_Waitsome instead of polling with MPI_Testsome on servers.\n");
+    fprintf(stream, "\t-n, --hostnames\tEnable hostname resulution with verbose mode.\n");
+    fprintf(stream, "\t-v, --verbose\tEnable verbose mode.\n");
+    fprintf(stream, "\t-h, --help\tHelp page.\n");
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        { "nservers",   required_argument, 0, 's' },
+        { "niters",     required_argument, 0, 'i' },
+        { "nflight",    required_argument, 0, 'f' },
+        { "help",       no_argument,       0, 'h' },
+        { "bsize",      required_argument, 0, 'b' },
+        { "sizes",      required_argument, 0, 'z' },
+        { "hostnames",  no_argument,       0, 'n' },
+        { "sequential", no_argument,       0, 't' },
+        { "batch",      no_argument,       0, 'w' },
+        { "bidirectional", no_argument,    0, 'd' },
+        { "pattern",    required_argument, 0, 'p' },
+        { "seed",       required_argument, 0, 'r' },
+        { "fanout",     required_argument, 0, 'K' },
+        { "intra-node", required_argument, 0, 'L' },
+        { "matrix",     required_argument, 0, 'M' },
+        { "matrix-export", required_argument, 0, 'E' },
+        { "analyze",    no_argument,       0, 'A' },
+        { "time-per-size", required_argument, 0, 'T' },
+        { "duration",   required_argument, 0, 'D' },
+        { "ci",         required_argument, 0, 'C' },
+        { "persistent", no_argument,       0, 'P' },
+        { "rma",        no_argument,       0, 'R' },
+        { "buffers",    required_argument, 0, 'm' },
+        { "numa",       required_argument, 0, 'N' },
+        { "verify",     no_argument,       0, 'V' },
+        { "monitor",    required_argument, 0, 'O' },
+        { "interval",   required_argument, 0, 'I' },
+        { "series",     required_argument, 0, 'W' },
+        { "clock-sync", no_argument,       0, 'Y' },
+        { "pairs",      no_argument,       0, 'Q' },
+        { "concurrent", required_argument, 0, 'G' },
+        { "triage",     required_argument, 0, 'X' },
+        { "calibrate",  no_argument,       0, 'c' },
+        { "results",    required_argument, 0, 'J' },
+        { "results-format", required_argument, 0, 'F' },
+        { "baseline",   required_argument, 0, 'U' },
+        { "tolerance",  required_argument, 0, 'H' },
+        { "expand",     required_argument, 0, 'x' },
+        { "expand-file", required_argument, 0, 'e' },
+        { "server-slots", required_argument, 0, 'S' },
+        { "server-blocking", no_argument,  0, 'B' },
+        { "verbose",    no_argument,       0, 'v' },
+        { 0,            0,                 0, 0 }
+    };
+
+    while (1) {
+        int c = getopt_long(argc, argv, "s:i:b:z:vh,f:,n,t,w,S:B,d,p:r:K:L:M:E:AT:D:C:PRm:N:VO:I:W:YQG:X:cJ:F:U:H:x:e:",
+                        long_options, NULL);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 's':
+                my.nservers = atoi(optarg);
+                break;
+            case 'i':
+                my.niters = atoi(optarg);
+                break;
+            case 'f':
+                my.nflight = atoi(optarg);
+                break;
+            case 'b':
+                free(my.sizes);
+                my.sizes = malloc(sizeof(*my.sizes));
+                assert(my.sizes);
+                my.sizes[0] = parse_size(optarg, optarg);
+                my.nsizes = 1;
+                break;
+            case 'z':
+                parse_sizes(optarg);
+                break;
+            case 'n':
+                my.hostname_resolve = true;
+                break;
+            case 't':
+                my.sequential_ios = true;
+                break;
+            case 'w':
+                my.batch_mode = true;
+                break;
+            case 'd':
+                my.bidirectional = true;
+                break;
+            case 'p':
+                my.pattern = _PATTERN_LAST;
+                for (int i = 0; i < _PATTERN_LAST; i++)
+                    if (strcmp(optarg, pattern_str[i]) == 0)
+                        my.pattern = i;
+                if (my.pattern == _PATTERN_LAST)
+                {
+                    fprintf(stderr, "Invalid pattern: %s\n", optarg);
+                    help_usage(argv[0], stderr);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'r':
+                my.seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'L':
+                my.intra_mode = _INTRA_LAST;
+                for (int i = 0; i < _INTRA_LAST; i++)
+                    if (strcmp(optarg, intra_mode_str[i]) == 0)
+                        my.intra_mode = i;
+                if (my.intra_mode == _INTRA_LAST)
+                {
+                    fprintf(stderr, "Invalid intra-node mode: %s\n", optarg);
+                    help_usage(argv[0], stderr);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'M':
+                my.matrix_prefix = optarg;
+                break;
+            case 'E':
+                my.matrix_export = _MATRIX_EXPORT_LAST;
+                for (int i = 0; i < _MATRIX_EXPORT_LAST; i++)
+                    if (strcmp(optarg, matrix_export_str[i]) == 0)
+                        my.matrix_export = i;
+                if (my.matrix_export == _MATRIX_EXPORT_LAST)
+                {
+                    fprintf(stderr, "Invalid matrix export: %s\n", optarg);
+                    help_usage(argv[0], stderr);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'A':
+                my.analyze = true;
+                break;
+            case 'T':
+                my.time_per_size = atof(optarg);
+                if (my.time_per_size <= 0)
+                {
+                    fprintf(stderr, "Invalid time per size: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'D':
+                my.duration = atof(optarg);
+                if (my.duration <= 0)
+                {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'C':
+                my.ci_target = atof(optarg);
+                if (my.ci_target < 0)
+                {
+                    fprintf(stderr, "Invalid confidence interval: %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'P':
+                my.persistent = true;
+                break;
+            case 'R':
+                my.alltoall_rma = true;
+                break;
+            case 'm':
+                my.buffer_kind = _BUFFER_LAST;
+                for (int i = 0; i < _BUFFER_LAST; i++)
+                    if (strcmp(optarg, buffer_kind_str[i]) == 0)
+                        my.buffer_kind = i;
+                if (my.buffer_kind == _BUFFER_LAST)
+                {
+                    fprintf(stderr, "Invalid buffers: %s\n", optarg);
+                    help_usage(argv[0], stderr);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'V':
+                my.verify = true;
+                break;
+            case 'O':
+                my.monitor = atof(optarg);
+                if (my.monitor <= 0)
+                {
+                    fprintf(stderr, "Invalid monitoring duration: %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'I':
+                my.interval = atof(optarg);
+                if (my.interval <= 0)
+                {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'W':
+                my.series_path = optarg;
+                break;
+            case 'Y':
+                my.clock_sync = true;
+                break;
+            case 'Q':
+                my.pairs = true;
+                break;
+            case 'c':
+                my.calibrate = true;
+                break;
+            case 'J':
+                my.results_path = optarg;
+                break;
+            case 'F':
+                my.results_format = _RESULTS_FORMAT_LAST;
+                for (int i = 0; i < _RESULTS_FORMAT_LAST; i++)
+                    if (strcmp(optarg, results_format_str[i]) == 0)
+                        my.results_format = i;
+                if (my.results_format == _RESULTS_FORMAT_LAST)
+                {
+                    fprintf(stderr, "Invalid results format: %s\n", optarg);
+                    help_usage(argv[0], stderr);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'U':
+                my.baseline_path = optarg;
+                break;
+            case 'H':
+                my.tolerance = atof(optarg);
+                if (my.tolerance < 0)
+                {
+                    fprintf(stderr, "Invalid tolerance: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'x':
+                my.expand = optarg;
+                break;
+            case 'e':
+                my.expand_file = optarg;
+                break;
+            case 'X':
+                my.triage = atof(optarg);
+                if (my.triage <= 0 || my.triage >= 100)
+                {
+                    fprintf(stderr, "Invalid triage threshold: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'G':
+                my.concurrent = atoi(optarg);
+                if (my.concurrent <= 0)
+                {
+                    fprintf(stderr, "Invalid number of concurrent pairs: %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'N':
+            {
+                char *end;
+                long node = strtol(optarg, &end, 10);
+
+                my.numa = optarg;
+                if (strcmp(optarg, "none") != 0 &&
+                    strcmp(optarg, "auto") != 0 &&
+                    (end == optarg || *end != '\0' ||
+                     node < 0 || node >= NUMA_MAX_NODES))
+                {
+                    fprintf(stderr, "Invalid NUMA node: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'K':
+                my.fanout = atoi(optarg);
+                if (my.fanout <= 0)
+                {
+                    fprintf(stderr, "Invalid fanout: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'S':
+                my.server_slots = atoi(optarg);
+                if (my.server_slots <= 0)
+                {
+                    fprintf(stderr, "Invalid number of server slots: %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'B':
+                my.server_blocking = true;
+                break;
+            case 'h':
+                help_usage(argv[0], stdout);
+                exit(EXIT_SUCCESS);
+                break;
+            case 'v':
+                my.output_mode = OUTPUT_VERBOSE;
+                break;
+            default:
+                fprintf(stderr, "Invalid argument: %s\n", optarg);
+                help_usage(argv[0], stderr);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (my.matrix_export != MATRIX_EXPORT_NONE && my.matrix_prefix == NULL)
+    {
+        fprintf(stderr, "--matrix-export needs --matrix\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void batch_client_server(struct test_config *config, void *arg)
+{
+    double *exec_time = arg;
+
+    *exec_time += run_test_client_server(config, NULL);
+}
+
+static void test_client_server(enum direction direction)
+{
+    int curr_iter = 0;
+    struct test_config test_config;
+
+    int nflight = is_server() ? my.server_slots : my.nflight;
+
+    /* Every slot has a region of the size of the largest message */
+    test_config.slot_size = max_size();
+    test_config.data_type = MPI_CHAR;
+
+    /* Allocate buffers */
+    test_config.s_buffer = allocate_buffer(nflight);
+    test_config.r_buffer = allocate_buffer(nflight);
+    test_config.hist = mallocz(sizeof(struct histogram) * _LINK_LAST);
+    assert(test_config.hist);
+
+    test_config.verify = alloc_verify_stats();
+    test_config.one_way = alloc_one_way_stats();
+    test_config.pairs = malloc(sizeof(struct pair_stats) *
+                               (is_server() ? my.nclients : my.nservers));
+    assert(test_config.pairs);
+    test_config.rdma_buffer = allocate_buffer(test_config.slot_size *
+                                              nflight);
+    MPI_CHECK(MPI_Win_create(test_config.rdma_buffer,
+                             (MPI_Aint) test_config.slot_size * nflight,
+                             1, /* disp unit */
+                             MPI_INFO_NULL,
+                             MPI_COMM_WORLD,
+                             &test_config.rdma_win));
+
+    /* Warmup test */
+    init_test(TEST_MODE_CLIENT_SERVER,
+              -1, NUM_RDMA_BUFFERS, nflight, 1, direction, &test_config);
+    run_test_client_server(&test_config, NULL);
+
+    if (my.output_mode == OUTPUT_MPI)
+        print_header_reduced(stdout);
+
+    for (int s = 0; s < my.nsizes; s++)
+    {
+        struct results res;
         double exec_time = 0;
 
-        init_test(TEST_MODE_CLIENT_SERVER,
-                  curr_iter++,
-                  my.niters, nflight, curr_size,
-                  direction,
-                  &test_config);
+        if (my.clock_sync)
+            clock_sync();
+
+        init_test(TEST_MODE_CLIENT_SERVER,
+                  curr_iter++,
+                  my.niters, nflight, my.sizes[s],
+                  direction,
+                  &test_config);
+
+        if (my.time_per_size > 0)
+        {
+            double probe_time = 0;
+
+            run_calibrated(&test_config, batch_client_server,
+                           &probe_time, &exec_time);
+        }
+        else
+            exec_time = run_test_client_server(&test_config, &res);
+
+        if (my.output_mode == OUTPUT_MPI)
+        {
+            int npeers = my.glob_rank < my.nservers ? my.nclients : my.nservers;
+            generate_results(&test_config, npeers, exec_time, &res);
+            print_results_reduced(&test_config, &res, test_config.hist,
+                                  "client-server", stdout);
+        }
+
+        if (test_config.verify)
+            report_verify(&test_config, stdout);
+        if (test_config.one_way)
+            report_clock(&test_config, stdout);
+        if (my.pairs || my.analyze || results_enabled())
+            report_pairs(&test_config, stdout);
+    }
+    flush_results_reduced();
+
+    MPI_CHECK(MPI_Win_free(&test_config.rdma_win));
+    destroy_buffer(test_config.rdma_buffer);
+    msg_type_free(&test_config.data_type);
+
+    destroy_buffer(test_config.s_buffer);
+    destroy_buffer(test_config.r_buffer);
+    free(test_config.hist);
+    free_verify_stats(test_config.verify);
+    free_one_way_stats(test_config.one_way);
+    free(test_config.pairs);
+}
+
+static int alltoall_get_abs_rank(int rel_rank, int step, int size)
+{
+    return ((rel_rank - 1 - step + (size - 1)) % (size - 1)) + 1;
+}
+
+/* This function is used the generate a list of remote peers the current rank
+ * will be communicating with.
+ * This algorithm has been inspired from the 'linktest' tool from FZ Julich:
+ * http://www.fz-juelich.de/ias/jsc/EN/Expertise/Support/Software/LinkTest/_node.html
+ * It has been modified to be simpler to read and adapted to the need of the
+ * network sanitizer.
+ */
+static struct peer_entry *
+alltoall_get_peers(int rank, int size)
+{
+    int maxp = (int) (size / 2);
+    int from, to;
+
+    struct peer_entry *peers_list = malloc(sizeof(struct peer_entry) * size);
+    if (peers_list == NULL)
+        return NULL;
+
+    for (int step = 0; step < size; step++) {
+
+        for (int p = 0; p < (maxp - 1); p++) {
+            from = alltoall_get_abs_rank(maxp - p, step, size);
+            to = alltoall_get_abs_rank(maxp + 1 + p, step, size);
+
+            if (from == rank)
+            {
+                peers_list[step].rank = to;
+                peers_list[step].role = PEER_RECV;
+            }
+            if (to == rank)
+            {
+                peers_list[step].rank = from;
+                peers_list[step].role = PEER_SEND;
+            }
+        }
+
+        from = 0;
+        to = alltoall_get_abs_rank(1, step, size);
+
+        if (from == rank)
+        {
+            peers_list[step].rank = to;
+            peers_list[step].role = PEER_RECV;
+        }
+        if (to == rank)
+        {
+            peers_list[step].rank = from;
+            peers_list[step].role = PEER_SEND;
+        }
+    }
+    return peers_list;
+}
+
+/* Add a peer to the first unused entry of a step */
+static void pattern_add_peer(struct peer_entry *peers_list, int width,
+                             int step, int rank, enum peer_role role)
+{
+    struct peer_entry *entry = &peers_list[step * width];
+
+    while (entry->rank != MPI_PROC_NULL)
+        entry++;
+    assert(entry < &peers_list[(step + 1) * width]);
+
+    entry->rank = rank;
+    entry->role = role;
+}
+
+/* xorshift64*: all the ranks draw the same sequence for a given seed */
+static uint64_t pattern_rand(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static bool pattern_needs_even(enum pattern pattern)
+{
+    return pattern == PATTERN_LINKTEST || pattern == PATTERN_BISECTION;
+}
+
+/* Generate the list of peers the current rank communicates with at every
+ * step of the given pattern. The list holds 'nsteps' steps of 'width'
+ * entries each */
+static struct peer_entry *
+pattern_get_peers(enum pattern pattern, int rank, int size,
+                  int *nsteps, int *width)
+{
+    struct peer_entry *peers_list;
+    const int half = size / 2;
+
+    if (pattern == PATTERN_LINKTEST)
+    {
+        *nsteps = size - 1;
+        *width = 1;
+        return alltoall_get_peers(rank, size);
+    }
+
+    switch (pattern)
+    {
+    case PATTERN_SHIFT:
+    case PATTERN_RANDOM:
+        *nsteps = size - 1;
+        *width = 2;
+        break;
+    case PATTERN_BISECTION:
+        *nsteps = half;
+        *width = 1;
+        break;
+    case PATTERN_INCAST:
+    case PATTERN_BROADCAST:
+        *nsteps = size;
+        *width = size - 1;
+        break;
+    case PATTERN_NEIGHBOR:
+        *nsteps = 2;
+        *width = 2;
+        break;
+    default:
+        assert(0);
+    }
+
+    peers_list = malloc(sizeof(struct peer_entry) * *nsteps * *width);
+    if (peers_list == NULL)
+        return NULL;
+    for (int i = 0; i < *nsteps * *width; i++)
+        peers_list[i].rank = MPI_PROC_NULL;
+
+    for (int step = 0; step < *nsteps; step++)
+    {
+        switch (pattern)
+        {
+        case PATTERN_SHIFT:
+            pattern_add_peer(peers_list, *width, step,
+                             (rank + step + 1) % size, PEER_SEND);
+            pattern_add_peer(peers_list, *width, step,
+                             (rank - step - 1 + size) % size, PEER_RECV);
+            break;
+
+        case PATTERN_RANDOM:
+        {
+            /* Shuffle the ranks, then each rank sends to the next one in
+             * the shuffled order, which never pairs a rank with itself */
+            uint64_t state = ((uint64_t) my.seed << 32) + step + 1;
+            int order[size];
+            int pos = 0;
+
+            for (int i = 0; i < size; i++)
+                order[i] = i;
+            for (int i = size - 1; i > 0; i--)
+            {
+                int j = pattern_rand(&state) % (i + 1);
+                int tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+            while (order[pos] != rank)
+                pos++;
+
+            pattern_add_peer(peers_list, *width, step,
+                             order[(pos + 1) % size], PEER_SEND);
+            pattern_add_peer(peers_list, *width, step,
+                             order[(pos - 1 + size) % size], PEER_RECV);
+            break;
+        }
+
+        case PATTERN_BISECTION:
+            if (rank < half)
+                pattern_add_peer(peers_list, *width, step,
+                                 half + (rank + step) % half, PEER_SEND);
+            else if (rank < 2 * half)
+                pattern_add_peer(peers_list, *width, step,
+                                 (rank - half - step + half) % half,
+                                 PEER_RECV);
+            break;
+
+        case PATTERN_INCAST:
+        case PATTERN_BROADCAST:
+        {
+            /* The rank 'step' is the target of all the other ranks */
+            const enum peer_role target_role =
+                pattern == PATTERN_INCAST ? PEER_RECV : PEER_SEND;
+            const enum peer_role other_role =
+                pattern == PATTERN_INCAST ? PEER_SEND : PEER_RECV;
+
+            if (rank == step)
+            {
+                for (int i = 0; i < size; i++)
+                    if (i != rank)
+                        pattern_add_peer(peers_list, *width, step,
+                                         i, target_role);
+            }
+            else
+                pattern_add_peer(peers_list, *width, step, step, other_role);
+            break;
+        }
+
+        case PATTERN_NEIGHBOR:
+        {
+            const int next = (rank + 1) % size;
+            const int prev = (rank - 1 + size) % size;
+
+            pattern_add_peer(peers_list, *width, step,
+                             step == 0 ? next : prev, PEER_SEND);
+            pattern_add_peer(peers_list, *width, step,
+                             step == 0 ? prev : next, PEER_RECV);
+            break;
+        }
+
+        default:
+            assert(0);
+        }
+    }
+
+    return peers_list;
+}
+
+/* Merge every 'fanout' consecutive steps into a single one, where the current
+ * rank communicates with all their peers at once. Every link of the pattern
+ * is still tested exactly once, in 'fanout' times less steps */
+static struct peer_entry *
+pattern_merge_steps(struct peer_entry *peers_list, int fanout,
+                    int *nsteps, int *width)
+{
+    const int merged_nsteps = (*nsteps + fanout - 1) / fanout;
+    const int merged_width = *width * fanout;
+    struct peer_entry *merged;
+
+    if (fanout <= 1)
+        return peers_list;
+
+    merged = malloc(sizeof(struct peer_entry) * merged_nsteps * merged_width);
+    if (merged == NULL)
+    {
+        free(peers_list);
+        return NULL;
+    }
+
+    for (int i = 0; i < merged_nsteps * merged_width; i++)
+        merged[i].rank = MPI_PROC_NULL;
+
+    /* Steps are stored one after the other, so step 'i' of the pattern
+     * simply lands in the (i % fanout)-th chunk of the merged step */
+    memcpy(merged, peers_list, sizeof(struct peer_entry) * *nsteps * *width);
+    free(peers_list);
+
+    *nsteps = merged_nsteps;
+    *width = merged_width;
+    return merged;
+}
+
+#if 0
+static void alltoall_print_peers(struct peer_entry *peers_list,
+                                 int nsteps, int width)
+{
+    for (int i = 0; i < nsteps * width; i++)
+        fprintf(stderr, "%d%s", peers_list[i].rank,
+                (i + 1) % width ? "," : " ");
+    fprintf(stderr, "\n");
+}
+#endif
+
+static struct step_scratch *alloc_step_scratch(int width, int nflight)
+{
+    /* Up to 2 reqs per message in bidirectional mode, +1 for response */
+    const size_t nreqs = (size_t) width * (nflight * 2 + 1);
+    struct step_scratch *sc = malloc(sizeof(*sc));
+    assert(sc);
+
+    sc->reqs      = malloc(nreqs * sizeof(*sc->reqs));
+    sc->persistent = malloc(nreqs * sizeof(*sc->persistent));
+    sc->indices   = malloc(nreqs * sizeof(*sc->indices));
+    sc->owners    = malloc(nreqs * sizeof(*sc->owners));
+    sc->slots     = malloc(nreqs * sizeof(*sc->slots));
+    sc->roles     = malloc(nreqs * sizeof(*sc->roles));
+    sc->stamps    = malloc(nreqs * sizeof(*sc->stamps));
+    sc->responses = malloc(width * sizeof(*sc->responses));
+    sc->times     = malloc(width * sizeof(*sc->times));
+    assert(sc->reqs && sc->persistent && sc->indices && sc->owners &&
+           sc->slots && sc->roles &&
+           sc->stamps && sc->responses && sc->times);
+
+    return sc;
+}
+
+static void free_step_scratch(struct step_scratch *sc)
+{
+    free(sc->reqs);
+    free(sc->persistent);
+    free(sc->indices);
+    free(sc->owners);
+    free(sc->slots);
+    free(sc->roles);
+    free(sc->stamps);
+    free(sc->responses);
+    free(sc->times);
+    free(sc);
+}
+
+/* Tag of the 1-byte responses which close each window of an all-to-all
+ * step */
+#define ALLTOALL_RESP_TAG 42
+
+/* Receive buffers (or window) of a rank in all-to-all mode, beyond which the
+ * regions are shared by several peers */
+#define ALLTOALL_RECV_MAX (1UL << 30)
+
+/* Receive region of slot 'k' of entry 'p', which is also the window region of
+ * the one-sided mode. Past ALLTOALL_RECV_MAX bytes, the widest patterns reuse
+ * the regions, see test_alltoall() */
+static inline size_t recv_region(const struct test_config *config, int p,
+                                 int k)
+{
+    return ((size_t) p * config->nflight + k) % config->recv_regions;
+}
+
+/* Index of the persistent request of a data message, in the scratch */
+static inline size_t step_persistent_data(const struct test_config *config,
+                                          int p, int k, enum peer_role role)
+{
+    return ((size_t) p * config->nflight + k) * 2 + role;
+}
+
+/* Index of the persistent request of a response, in the scratch */
+static inline size_t step_persistent_resp(const struct test_config *config,
+                                          int p)
+{
+    return (size_t) config->step_width * config->nflight * 2 + p;
+}
+
+/* Create the persistent requests of a step, for all its peers and window
+ * slots, with the same buffers as the non-persistent ones */
+static void step_init_persistent(const struct peer_entry *peers,
+                                 const struct test_config *config)
+{
+    const size_t data_size = config->data_size;
+    const int nflight   = config->nflight;
+    const int width     = config->step_width;
+    const bool bidi     = my.bidirectional;
+    char *s_buffer      = config->s_buffer;
+    char *r_buffer      = config->r_buffer;
+    struct step_scratch *sc = config->scratch;
+
+    for (size_t i = 0; i < step_persistent_resp(config, width); i++)
+        sc->persistent[i] = MPI_REQUEST_NULL;
+
+    for (int p = 0; p < width; p++)
+    {
+        const int peer_rank = peers[p].rank;
+        const enum peer_role peer_role = peers[p].role;
+
+        if (peer_rank == MPI_PROC_NULL)
+            continue;
+
+        for (int k = 0; k < nflight; k++)
+        {
+            if (bidi || peer_role == PEER_RECV)
+                MPI_CHECK(MPI_Recv_init(
+                    &r_buffer[recv_region(config, p, k) * data_size],
+                    config->data_count, config->data_type, peer_rank, 0,
+                    MPI_COMM_WORLD,
+                    &sc->persistent[step_persistent_data(config, p, k,
+                                                         PEER_RECV)]));
+            if (bidi || peer_role == PEER_SEND)
+                MPI_CHECK(MPI_Send_init(
+                    &s_buffer[(size_t) k * data_size],
+                    config->data_count, config->data_type, peer_rank, 0,
+                    MPI_COMM_WORLD,
+                    &sc->persistent[step_persistent_data(config, p, k,
+                                                         PEER_SEND)]));
+        }
+
+        if (bidi)
+            continue;
+
+        if (peer_role == PEER_RECV)
+            MPI_CHECK(MPI_Send_init(&sc->responses[p], 1, MPI_CHAR,
+                                    peer_rank, ALLTOALL_RESP_TAG,
+                                    MPI_COMM_WORLD,
+                                    &sc->persistent[step_persistent_resp(
+                                        config, p)]));
+        else
+            MPI_CHECK(MPI_Recv_init(&sc->responses[p], 1, MPI_CHAR,
+                                    peer_rank, ALLTOALL_RESP_TAG,
+                                    MPI_COMM_WORLD,
+                                    &sc->persistent[step_persistent_resp(
+                                        config, p)]));
+    }
+}
+
+static void step_free_persistent(const struct test_config *config)
+{
+    struct step_scratch *sc = config->scratch;
+
+    for (size_t i = 0; i < step_persistent_resp(config, config->step_width);
+         i++)
+        if (sc->persistent[i] != MPI_REQUEST_NULL)
+            MPI_CHECK(MPI_Request_free(&sc->persistent[i]));
+}
+
+/* One-sided flavor of the all-to-all steps: config->direction is DIR_PUT
+ * or DIR_GET instead of DIR_NONE */
+static inline bool alltoall_is_rma(const struct test_config *config)
+{
+    return config->direction == DIR_PUT || config->direction == DIR_GET;
+}
+
+/* Whether the current rank initiates the one-sided operations of a peer
+ * entry: Put is initiated by the sender, Get by the receiver, and both ends
+ * initiate in bidirectional mode */
+static inline bool rma_is_initiator(enum direction direction,
+                                    enum peer_role role)
+{
+    return my.bidirectional ||
+           role == (direction == DIR_PUT ? PEER_SEND : PEER_RECV);
+}
+
+/* Seed of a window region in one-sided mode, derived from the rank which
+ * owns the window, so that data read from or written to the wrong window is
+ * caught. Get regions are filled by their owner. Put regions may be shared
+ * by several initiators, which all write the same pattern to them, so the
+ * seed can not tell the initiators of a region apart */
+static inline uint64_t rma_region_seed(enum direction direction, int owner,
+                                       size_t region)
+{
+    return verify_seed(direction, region, owner);
+}
+
+/* Fill every region of the window of the current rank for the Get steps */
+static void rma_verify_fill_window(const struct test_config *config)
+{
+    for (size_t region = 0; region < config->recv_regions; region++)
+        verify_fill((char *) config->rdma_buffer + region * config->data_size,
+                    config->data_size,
+                    rma_region_seed(DIR_GET, my.glob_rank, region));
+    MPI_CHECK(MPI_Win_sync(config->rdma_win));
+}
+
+/* Put verification on the target side: the regions written by the
+ * initiators of a step are cleared before it starts, and checked once all
+ * of them completed. Errors are counted for the initiator, or the first one
+ * of those which share the region */
+static void rma_verify_put_targets(const struct peer_entry *peers,
+                                   const struct test_config *config,
+                                   bool check)
+{
+    const int width = config->step_width;
+    const int nflight = config->nflight;
+    const int nslots = MIN(nflight, config->niters);
+
+    MPI_CHECK(MPI_Win_sync(config->rdma_win));
+
+    for (int p = 0; p < width; p++)
+    {
+        const int peer_rank = peers[p].rank;
+
+        if (peer_rank == MPI_PROC_NULL ||
+            (!my.bidirectional && peers[p].role != PEER_RECV))
+            continue;
+
+        for (int k = 0; k < nslots; k++)
+        {
+            const size_t region = recv_region(config, peer_rank % width, k);
+            char *data = (char *) config->rdma_buffer +
+                         region * config->data_size;
+
+            if (check)
+                verify_check(config->verify, peer_rank, data,
+                             config->data_size,
+                             rma_region_seed(DIR_PUT, my.glob_rank, region));
+            else
+                verify_clear(data, config->data_size);
+        }
+    }
+
+    MPI_CHECK(MPI_Win_sync(config->rdma_win));
+}
+
+/* Run a step with passive-target Put/Get into the windows of the peers. The
+ * window of every rank has one region per (entry, slot), like the receive
+ * buffers. The operations of a window of nflight iterations are completed
+ * with MPI_Win_flush, peer by peer. Only the entries initiated by the current
+ * rank get their times updated */
+static double run_test_alltoall_step_rma(const struct peer_entry *peers,
+                                         const struct test_config *config)
+{
+    double start, end;
+    int k = 0; /* Number of slots in use */
+
+    const int niters    = config->niters;
+    const size_t data_size = config->data_size;
+    const int nflight   = config->nflight;
+    const int width     = config->step_width;
+    char *s_buffer      = config->s_buffer;
+    char *r_buffer      = config->r_buffer;
+    struct step_scratch *sc = config->scratch;
+    const bool verify_put = config->verify && config->direction == DIR_PUT;
+
+    /* Region of the target windows written by the current rank. Several
+     * ranks may share it in the widest patterns, the content of the
+     * windows does not matter */
+    const MPI_Aint target_entry = my.glob_rank % width;
+
+    /* The Put patterns do not depend on the iteration, but on the target:
+     * every peer gets its own send slots */
+    for (int p = 0; p < width && verify_put; p++)
+        for (int i = 0; i < nflight; i++)
+            verify_fill(&s_buffer[((size_t) p * nflight + i) * data_size],
+                        data_size,
+                        rma_region_seed(DIR_PUT, peers[p].rank,
+                                        recv_region(config, target_entry, i)));
+
+    end = start = MPI_Wtime();
+
+    for (int j = 0; j < niters; j++)
+    {
+        /* All the operations of an iteration share the same stamp */
+        sc->stamps[k] = MPI_Wtime();
+
+        for (int p = 0; p < width; p++)
+        {
+            const int peer_rank = peers[p].rank;
+
+            if (peer_rank == MPI_PROC_NULL ||
+                !rma_is_initiator(config->direction, peers[p].role))
+                continue;
+
+            if (config->direction == DIR_PUT)
+                MPI_CHECK(MPI_Put(&s_buffer[((verify_put ? (size_t) p *
+                                              nflight : 0) + k) * data_size],
+                                  config->data_count, config->data_type,
+                                  peer_rank,
+                                  recv_region(config, target_entry, k) *
+                                  data_size,
+                                  config->data_count, config->data_type,
+                                  config->rdma_win));
+            else
+            {
+                if (config->verify)
+                    verify_clear(&r_buffer[recv_region(config, p, k) *
+                                           data_size], data_size);
+                MPI_CHECK(MPI_Get(&r_buffer[recv_region(config, p, k) *
+                                            data_size],
+                                  config->data_count, config->data_type,
+                                  peer_rank,
+                                  recv_region(config, target_entry, k) *
+                                  data_size,
+                                  config->data_count, config->data_type,
+                                  config->rdma_win));
+            }
+        }
+
+        if (++k < nflight && j < niters - 1)
+            continue;
+
+        /* Nflight reached or last iteration, complete the operations of
+         * every peer */
+        for (int p = 0; p < width; p++)
+        {
+            if (peers[p].rank == MPI_PROC_NULL ||
+                !rma_is_initiator(config->direction, peers[p].role))
+                continue;
+
+            MPI_CHECK(MPI_Win_flush(peers[p].rank, config->rdma_win));
+            end = MPI_Wtime();
+
+            for (int i = 0; i < k; i++)
+                hist_record(&config->hist[get_link_class(peers[p].rank)],
+                            end - sc->stamps[i]);
+            sc->times[p].tx = sc->times[p].rx = sc->times[p].all =
+                end - start;
+
+            for (int i = 0; i < k && config->verify &&
+                            config->direction == DIR_GET; i++)
+                verify_check(config->verify, peers[p].rank,
+                             &r_buffer[recv_region(config, p, i) * data_size],
+                             data_size,
+                             rma_region_seed(DIR_GET, peers[p].rank,
+                                             recv_region(config, target_entry,
+                                                         i)));
+        }
+        k = 0;
+    }
+
+    return (end - start);
+}
+
+/* Check the messages received in a window of 'count' iterations, starting
+ * at iteration 'first'. Senders fill their slot with a seed of their rank and
+ * the iteration */
+static void alltoall_verify_recv(const struct peer_entry *peers,
+                                 const struct test_config *config,
+                                 int count, int first)
+{
+    const size_t data_size = config->data_size;
+    const char *r_buffer = config->r_buffer;
+
+    for (int p = 0; p < config->step_width; p++)
+    {
+        if (peers[p].rank == MPI_PROC_NULL ||
+            (!my.bidirectional && peers[p].role != PEER_RECV))
+            continue;
+
+        for (int i = 0; i < count; i++)
+            verify_check(config->verify, peers[p].rank,
+                         &r_buffer[recv_region(config, p, i) * data_size],
+                         data_size,
+                         verify_seed(peers[p].rank, i, first + i));
+    }
+}
+
+/* Run one step of the pattern: the current rank communicates with all the
+ * peers of the step at once. The times of each peer entry are stored in the
+ * scratch space, unused entries are left untouched */
+static double run_test_alltoall_step(const struct peer_entry *peers,
+                                     const struct test_config *config)
+{
+    double start, end;
+    int k = 0; /* Number of slots in use */
+    int n = 0; /* Number of data requests posted */
+
+    const int niters    = config->niters;
+    const size_t data_size = config->data_size;
+    const int nflight   = config->nflight;
+    const int width     = config->step_width;
+    const bool bidi     = my.bidirectional;
+    char *s_buffer      = config->s_buffer;
+    char *r_buffer      = config->r_buffer;
+    const bool persistent = my.persistent;
+    struct step_scratch *sc = config->scratch;
+    bool sends = false;
+
+    if (alltoall_is_rma(config))
+        return run_test_alltoall_step_rma(peers, config);
+
+    /* Set up the requests out of the timed loop */
+    if (persistent)
+        step_init_persistent(peers, config);
+
+    /* Make sure 'end' gets always initialized */
+    end = start = MPI_Wtime();
+
+    for (int p = 0; p < width; p++)
+    {
+        sc->times[p].tx = sc->times[p].rx = sc->times[p].all = 0;
+        sends |= peers[p].rank != MPI_PROC_NULL &&
+                 (bidi || peers[p].role == PEER_SEND);
+    }
+
+    for (int j = 0; j < niters; j++)
+    {
+        const double now = MPI_Wtime();
+        const int first = n;
+
+        /* The send slot is shared by all the peers of the step */
+        if (config->verify && sends)
+            verify_fill(&s_buffer[(size_t) k * data_size], data_size,
+                        verify_seed(my.glob_rank, k, j));
+        if (config->one_way && sends)
+            stamp_message(&s_buffer[(size_t) k * data_size], data_size, now);
+
+        for (int p = 0; p < width; p++)
+        {
+            const int peer_rank = peers[p].rank;
+            const enum peer_role peer_role = peers[p].role;
+
+            if (peer_rank == MPI_PROC_NULL)
+                continue;
+
+            /* In bidirectional mode, both peers send and receive at once.
+             * Every peer gets its own receive buffers, while the send
+             * buffers are shared */
+            if (bidi || peer_role == PEER_RECV)
+            {
+                if (config->verify)
+                    verify_clear(&r_buffer[recv_region(config, p, k) *
+                                           data_size], data_size);
+                if (persistent)
+                    sc->reqs[n] = sc->persistent[
+                        step_persistent_data(config, p, k, PEER_RECV)];
+                else
+                    MPI_CHECK(MPI_Irecv(&r_buffer[recv_region(config, p, k) *
+                                                  data_size],
+                                        config->data_count,
+                                        config->data_type, peer_rank, 0,
+                                        MPI_COMM_WORLD, &sc->reqs[n]));
+                sc->owners[n] = p;
+                sc->slots[n] = k;
+                sc->roles[n] = PEER_RECV;
+                sc->stamps[n++] = now;
+            }
+            if (bidi || peer_role == PEER_SEND)
+            {
+                if (persistent)
+                    sc->reqs[n] = sc->persistent[
+                        step_persistent_data(config, p, k, PEER_SEND)];
+                else
+                    MPI_CHECK(MPI_Isend(&s_buffer[(size_t) k * data_size],
+                                        config->data_count,
+                                        config->data_type, peer_rank, 0,
+                                        MPI_COMM_WORLD, &sc->reqs[n]));
+                sc->owners[n] = p;
+                sc->slots[n] = k;
+                sc->roles[n] = PEER_SEND;
+                sc->stamps[n++] = now;
+            }
+        }
+
+        if (persistent)
+            MPI_CHECK(MPI_Startall(n - first, &sc->reqs[first]));
+
+        /* Nflight reached or last iteration, now send the responses and
+         * wait for all reqs (including the responses) to complete */
+        if (++k >= nflight || (j == niters - 1))
+        {
+            int nreqs = n;
+
+            /* Send / Recv responses. Not needed in bidirectional mode,
+             * where each peer already waits for the data of the other
+             * one */
+            for (int p = 0; p < width && !bidi; p++)
+            {
+                if (peers[p].rank == MPI_PROC_NULL)
+                    continue;
+
+                sc->owners[nreqs] = p;
+                if (peers[p].role == PEER_RECV)
+                {
+                    sc->responses[p] = 'o';
+                    if (persistent)
+                        sc->reqs[nreqs++] =
+                            sc->persistent[step_persistent_resp(config, p)];
+                    else
+                        MPI_CHECK(MPI_Isend(&sc->responses[p], 1,
+                                            MPI_CHAR, peers[p].rank,
+                                            ALLTOALL_RESP_TAG, MPI_COMM_WORLD,
+                                            &sc->reqs[nreqs++]));
+                }
+                else
+                {
+                    assert(peers[p].role == PEER_SEND);
+                    sc->responses[p] = 'x';
+                    if (persistent)
+                        sc->reqs[nreqs++] =
+                            sc->persistent[step_persistent_resp(config, p)];
+                    else
+                        MPI_CHECK(MPI_Irecv(&sc->responses[p], 1,
+                                            MPI_CHAR, peers[p].rank,
+                                            ALLTOALL_RESP_TAG, MPI_COMM_WORLD,
+                                            &sc->reqs[nreqs++]));
+                }
+            }
+
+            if (persistent)
+                MPI_CHECK(MPI_Startall(nreqs - n, &sc->reqs[n]));
+
+            /* Wait for all the reqs, timestamping every message as it
+             * completes */
+            for (int remaining = nreqs; remaining > 0;)
+            {
+                int outcount;
+
+                MPI_CHECK(MPI_Waitsome(nreqs, sc->reqs, &outcount,
+                                       sc->indices, MPI_STATUSES_IGNORE));
+                end = MPI_Wtime();
+                remaining -= outcount;
+
+                for (int i = 0; i < outcount; i++)
+                {
+                    const int idx = sc->indices[i];
+                    const int p = sc->owners[idx];
+
+                    sc->times[p].all = end - start;
+                    if (idx >= n)
+                        continue; /* Response message */
+
+                    hist_record(&config->hist[get_link_class(peers[p].rank)],
+                                end - sc->stamps[idx]);
+                    if (sc->roles[idx] == PEER_RECV)
+                    {
+                        sc->times[p].rx = end - start;
+                        if (config->one_way)
+                            record_one_way(config->one_way, peers[p].rank,
+                                           &r_buffer[recv_region(config, p,
+                                                          sc->slots[idx]) *
+                                                     data_size],
+                                           data_size, end);
+                    }
+                    else
+                        sc->times[p].tx = end - start;
+                }
+            }
+
+            for (int p = 0; p < width && !bidi; p++)
+                assert(peers[p].rank == MPI_PROC_NULL ||
+                       sc->responses[p] == 'o');
+            if (config->verify)
+                alltoall_verify_recv(peers, config, k, j + 1 - k);
+            k = n = 0;
+        }
+    }
+
+    if (persistent)
+        step_free_persistent(config);
+
+    return (end - start);
+}
+
+/* Keep the bandwidth of the flows of a step for the matrix. Every flow is
+ * measured on its receiving side, once the data has arrived. A client may
+ * have several flows in a step, e.g. with --fanout: they run at once, so
+ * their data adds up over the time of the slowest one */
+static void record_pair_bw(const struct peer_entry *peers,
+                           const struct test_config *config)
+{
+    const struct step_scratch *sc = config->scratch;
+    struct pair_flows *flows = config->flows;
+
+    if (config->pair_bw == NULL)
+        return;
+
+    for (int p = 0; p < config->step_width; p++)
+    {
+        struct results res;
+        const int src = peers[p].rank;
+
+        if (src == MPI_PROC_NULL ||
+            (!my.bidirectional && peers[p].role != PEER_RECV))
+            continue;
+
+        generate_results(config, 1, sc->times[p].rx, &res);
+        flows->mb[src] += res.bw * sc->times[p].rx;
+        flows->step_time[src] = MAX(flows->step_time[src], sc->times[p].rx);
+    }
+
+    for (int p = 0; p < config->step_width; p++)
+    {
+        const int src = peers[p].rank;
+
+        if (src == MPI_PROC_NULL || flows->step_time[src] == 0)
+            continue;
+
+        flows->time[src] += flows->step_time[src];
+        flows->step_time[src] = 0;
+        config->pair_bw[src] = flows->mb[src] / flows->time[src];
+    }
+}
+
+/* Sequential mode: every rank gets a turn per step, where it receives from
+ * all its peers of the step, which send to it. The turns are chained with
+ * tokens rather than global barriers: the ranks are split in 'concurrent'
+ * lanes of consecutive ranks, whose turns run one after the other, while the
+ * lanes run side by side. Every rank goes through its turns in the same
+ * global order, where the turns of the lanes are interleaved, so that the
+ * chains never wait on each other in a cycle. The control messages have
+ * their own communicator, to never match the data ones */
+#define SEQ_GO_TAG    0 /* Receiver to senders: start the turn */
+#define SEQ_DONE_TAG  1 /* Senders to receiver: turn over */
+#define SEQ_TOKEN_TAG 2 /* Receiver to the next one of its lane */
+
+static MPI_Comm seq_comm = MPI_COMM_NULL;
+
+static inline int seq_lane_size(void)
+{
+    const int nlanes = MIN(my.concurrent, my.nclients);
+
+    return (my.nclients + nlanes - 1) / nlanes;
+}
+
+/* Position of the turn of a rank in the global order */
+static inline int seq_turn_key(int rank)
+{
+    const int lane_size = seq_lane_size();
+
+    return (rank % lane_size) * my.concurrent + rank / lane_size;
+}
+
+static void run_sequential_step(const struct peer_entry *peers,
+                                const struct test_config *config)
+{
+    const int width = config->step_width;
+    const int lane_size = seq_lane_size();
+    const bool verify_put = config->verify && config->direction == DIR_PUT;
+    struct peer_entry seq_peers[width];
+    int turns[width + 1];
+    int nturns = 0;
+
+    /* Turns the current rank takes part in: its own, where it receives from
+     * its senders, and the ones of the peers it sends to, in the global
+     * order. Every link runs once, in the direction of the pattern */
+    turns[nturns++] = my.glob_rank;
+    for (int p = 0; p < width; p++)
+    {
+        bool known = peers[p].rank == MPI_PROC_NULL ||
+                     peers[p].role != PEER_SEND;
+
+        for (int t = 0; t < nturns && !known; t++)
+            known = turns[t] == peers[p].rank;
+        if (!known)
+            turns[nturns++] = peers[p].rank;
+    }
+    for (int t = 1; t < nturns; t++)
+    {
+        for (int u = t; u > 0 &&
+             seq_turn_key(turns[u]) < seq_turn_key(turns[u - 1]); u--)
+        {
+            const int tmp = turns[u];
+
+            turns[u] = turns[u - 1];
+            turns[u - 1] = tmp;
+        }
+    }
+
+    for (int t = 0; t < nturns; t++)
+    {
+        const int turn = turns[t];
+        const bool mine = turn == my.glob_rank;
+        int nentries = 0;
+
+        for (int p = 0; p < width; p++)
+        {
+            seq_peers[p].rank = MPI_PROC_NULL;
+            if (peers[p].rank == MPI_PROC_NULL ||
+                peers[p].role != (mine ? PEER_RECV : PEER_SEND) ||
+                (!mine && peers[p].rank != turn))
+                continue;
+
+            seq_peers[p] = peers[p];
+            nentries++;
+        }
+
+        if (mine)
+        {
+            /* Wait for the previous turn of the lane, then release the
+             * senders, one message per entry */
+            if (turn % lane_size)
+                MPI_CHECK(MPI_Recv(NULL, 0, MPI_BYTE, turn - 1, SEQ_TOKEN_TAG,
+                                   seq_comm, MPI_STATUS_IGNORE));
+            if (verify_put)
+                rma_verify_put_targets(seq_peers, config, false);
+            for (int p = 0; p < width; p++)
+                if (seq_peers[p].rank != MPI_PROC_NULL)
+                    MPI_CHECK(MPI_Send(NULL, 0, MPI_BYTE, seq_peers[p].rank,
+                                       SEQ_GO_TAG, seq_comm));
+        }
+        else
+        {
+            for (int n = 0; n < nentries; n++)
+                MPI_CHECK(MPI_Recv(NULL, 0, MPI_BYTE, turn, SEQ_GO_TAG,
+                                   seq_comm, MPI_STATUS_IGNORE));
+        }
+
+        run_test_alltoall_step(seq_peers, config);
+        record_pair_bw(seq_peers, config);
+
+        if (mine)
+        {
+            /* The senders are done, and their Put operations flushed */
+            for (int p = 0; p < width; p++)
+                if (seq_peers[p].rank != MPI_PROC_NULL)
+                    MPI_CHECK(MPI_Recv(NULL, 0, MPI_BYTE, seq_peers[p].rank,
+                                       SEQ_DONE_TAG, seq_comm,
+                                       MPI_STATUS_IGNORE));
+            if (verify_put)
+                rma_verify_put_targets(seq_peers, config, true);
+            if ((turn + 1) % lane_size && turn + 1 < my.nclients)
+                MPI_CHECK(MPI_Send(NULL, 0, MPI_BYTE, turn + 1,
+                                   SEQ_TOKEN_TAG, seq_comm));
+        }
+        else
+        {
+            for (int n = 0; n < nentries; n++)
+                MPI_CHECK(MPI_Send(NULL, 0, MPI_BYTE, turn, SEQ_DONE_TAG,
+                                   seq_comm));
+        }
+    }
+}
+
+/* Run all the steps of the pattern. The time spent by the current rank is
+ * accumulated per link class */
+static void run_test_alltoall(const struct test_config *config,
+                              struct step_times total_times[_LINK_LAST])
+{
+    const int width = config->step_width;
+    struct step_scratch *sc = config->scratch;
+    const bool verify_put = config->verify && config->direction == DIR_PUT;
+
+    if (my.output_mode == OUTPUT_VERBOSE)
+        print_header_verbose(config);
+
+    memset(total_times, 0, sizeof(struct step_times) * _LINK_LAST);
+
+    /* The step barriers make the patterns visible to the Get initiators */
+    if (config->verify && config->direction == DIR_GET)
+        rma_verify_fill_window(config);
+
+    for (int step = 0; step < config->nsteps; step++)
+    {
+        const struct peer_entry *peers = &config->peers_list[step * width];
+        struct step_times step_times[_LINK_LAST];
+        double step_start;
+
+        /* The one-sided steps only time the entries they initiate */
+        memset(sc->times, 0, sizeof(*sc->times) * width);
+
+        if (verify_put && !my.sequential_ios)
+            rma_verify_put_targets(peers, config, false);
+
+        MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+        step_start = MPI_Wtime();
+
+        if (my.sequential_ios)
+            run_sequential_step(peers, config);
+        else
+        {
+            run_test_alltoall_step(peers, config);
+            record_pair_bw(peers, config);
+
+            if (verify_put)
+            {
+                MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+                rma_verify_put_targets(peers, config, true);
+            }
+        }
+
+        one_way_mark(config->one_way, step_start, MPI_Wtime());
+
+        /* The peers of a step run concurrently: the step lasts as long as
+         * its slowest peer, for each link class */
+        memset(step_times, 0, sizeof(step_times));
+        for (int p = 0; p < width; p++)
+        {
+            struct step_times *t;
+
+            if (peers[p].rank == MPI_PROC_NULL)
+                continue;
+
+            t = &step_times[get_link_class(peers[p].rank)];
+            t->tx  = MAX(t->tx,  sc->times[p].tx);
+            t->rx  = MAX(t->rx,  sc->times[p].rx);
+            t->all = MAX(t->all, sc->times[p].all);
+        }
+
+        for (int c = 0; c < _LINK_LAST; c++)
+        {
+            total_times[c].tx  += step_times[c].tx;
+            total_times[c].rx  += step_times[c].rx;
+            total_times[c].all += step_times[c].all;
+        }
+
+        if (my.output_mode != OUTPUT_VERBOSE)
+            continue;
+
+        for (int p = 0; p < width; p++)
+        {
+            struct results res;
+
+            if (peers[p].rank == MPI_PROC_NULL ||
+                (alltoall_is_rma(config) && sc->times[p].all == 0))
+                continue;
+
+            if (my.bidirectional && !alltoall_is_rma(config))
+            {
+                for (int r = 0; r < 3; r++)
+                {
+                    struct test_config row;
+
+                    generate_results_bidi(config, 1, &sc->times[p],
+                                          bidi_rows[r], &row, &res);
+                    print_results_verbose(&row, peers[p].rank, &res);
+                }
+            }
+            else
+            {
+                generate_results(config, 1, sc->times[p].all, &res);
+                print_results_verbose(config, peers[p].rank, &res);
+            }
+        }
+    }
+}
+
+/* Bandwidth of the flows received by the current rank from every client, for
+ * every size of the sweep. The columns of all the ranks make a dense src x dst
+ * matrix per size, where the flows that were not tested are 0 */
+struct pair_matrix
+{
+    int nsizes;
+    int nranks;
+    uint64_t *sizes;
+    float *bw; /* nsizes x nranks, indexed by source rank */
+};
+
+/* Header of the binary matrix file. It is followed by the hostnames
+ * ('nranks' x 'host_size' bytes), the sizes ('nsizes' x uint64_t) and the
+ * matrices ('nsizes' x 'nranks' x 'nranks' float, in MB/s, row = source,
+ * column = destination), all in the native byte order */
+#define MATRIX_MAGIC   "NETSANMX"
+#define MATRIX_VERSION 1
+
+struct matrix_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nranks;
+    uint32_t nsizes;
+    uint32_t host_size;
+};
+
+static void alloc_matrix(struct pair_matrix *matrix)
+{
+    matrix->nsizes = my.nsizes;
+    matrix->nranks = my.nclients;
+
+    matrix->sizes = malloc(sizeof(uint64_t) * matrix->nsizes);
+    matrix->bw = calloc((size_t) matrix->nsizes * matrix->nranks,
+                        sizeof(float));
+    assert(matrix->sizes && matrix->bw);
+
+    for (int i = 0; i < my.nsizes; i++)
+        matrix->sizes[i] = my.sizes[i];
+}
+
+static void free_matrix(struct pair_matrix *matrix)
+{
+    free(matrix->sizes);
+    free(matrix->bw);
+    matrix->sizes = NULL;
+    matrix->bw = NULL;
+}
+
+/* Bandwidth from 'src' to 'dst' for size index 's', in a matrix gathered by
+ * gather_matrix() */
+static inline float matrix_get(const struct pair_matrix *matrix,
+                               const float *all_bw, int s, int src, int dst)
+{
+    return all_bw[((size_t) dst * matrix->nsizes + s) * matrix->nranks + src];
+}
+
+/* Gather the columns of all the ranks on the root. Returns NULL on the other
+ * ranks */
+static float *gather_matrix(const struct pair_matrix *matrix)
+{
+    const int count = matrix->nsizes * matrix->nranks;
+    float *all_bw = NULL;
+    int client_rank;
+
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &client_rank));
+    if (client_rank == MPI_ROOT_RANK)
+    {
+        all_bw = malloc(sizeof(float) * count * matrix->nranks);
+        assert(all_bw);
+    }
+
+    MPI_CHECK(MPI_Gather(matrix->bw, count, MPI_FLOAT,
+                         all_bw, count, MPI_FLOAT,
+                         MPI_ROOT_RANK, clients_comm));
+    return all_bw;
+}
+
+static void write_matrix_csv(FILE *stream, const struct pair_matrix *matrix,
+                             const float *all_bw)
+{
+    for (int s = 0; s < matrix->nsizes; s++)
+    {
+        fprintf(stream, "%"PRIu64, matrix->sizes[s]);
+        for (int dst = 0; dst < matrix->nranks; dst++)
+            fprintf(stream, ",%s", get_hostname(dst, true));
+        fprintf(stream, "\n");
+
+        for (int src = 0; src < matrix->nranks; src++)
+        {
+            fprintf(stream, "%s", get_hostname(src, true));
+            for (int dst = 0; dst < matrix->nranks; dst++)
+                fprintf(stream, ",%.0f",
+                        matrix_get(matrix, all_bw, s, src, dst));
+            fprintf(stream, "\n");
+        }
+    }
+}
+
+static void write_matrix_json(FILE *stream, const struct pair_matrix *matrix,
+                              const float *all_bw)
+{
+    fprintf(stream, "{\n  \"unit\": \"MB/s\",\n  \"hosts\": [");
+    for (int i = 0; i < matrix->nranks; i++)
+        fprintf(stream, "%s\"%s\"", i ? ", " : "", get_hostname(i, true));
+    fprintf(stream, "],\n  \"sizes\": [");
+    for (int s = 0; s < matrix->nsizes; s++)
+        fprintf(stream, "%s%"PRIu64, s ? ", " : "", matrix->sizes[s]);
+    fprintf(stream, "],\n  \"bw\": [\n");
+
+    for (int s = 0; s < matrix->nsizes; s++)
+    {
+        fprintf(stream, "    [\n");
+        for (int src = 0; src < matrix->nranks; src++)
+        {
+            fprintf(stream, "      [");
+            for (int dst = 0; dst < matrix->nranks; dst++)
+                fprintf(stream, "%s%.0f", dst ? ", " : "",
+                        matrix_get(matrix, all_bw, s, src, dst));
+            fprintf(stream, "]%s\n", src < matrix->nranks - 1 ? "," : "");
+        }
+        fprintf(stream, "    ]%s\n", s < matrix->nsizes - 1 ? "," : "");
+    }
+    fprintf(stream, "  ]\n}\n");
+}
+
+/* Length of the hostnames in the matrix file: the longest one, with its
+ * terminating NUL */
+static size_t matrix_host_size(const struct pair_matrix *matrix)
+{
+    size_t host_size = 0;
+
+    for (int rank = 0; rank < matrix->nranks; rank++)
+        host_size = MAX(host_size, strlen(get_hostname(rank, true)) + 1);
+    return host_size;
+}
+
+/* Write the matrix to '<prefix>.bin' with MPI-IO, every rank writing its own
+ * column, then optionally export the gathered matrix from the root */
+static void write_matrix(const struct pair_matrix *matrix,
+                         const float *all_bw, const char *prefix)
+{
+    const size_t host_size = matrix_host_size(matrix);
+    const MPI_Offset hosts_off = sizeof(struct matrix_header);
+    const MPI_Offset sizes_off = hosts_off + host_size * matrix->nranks;
+    const MPI_Offset data_off = sizes_off + sizeof(uint64_t) * matrix->nsizes;
+    char path[PATH_MAX];
+    MPI_Datatype column_type;
+    MPI_File file;
+    int client_rank;
+
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &client_rank));
+
+    snprintf(path, sizeof(path), "%s.bin", prefix);
+    MPI_CHECK(MPI_File_open(clients_comm, path,
+                            MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                            MPI_INFO_NULL, &file));
+    MPI_CHECK(MPI_File_set_size(file, 0));
+
+    if (client_rank == MPI_ROOT_RANK)
+    {
+        struct matrix_header header;
+
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MATRIX_MAGIC, sizeof(header.magic));
+        header.version = MATRIX_VERSION;
+        header.nranks = matrix->nranks;
+        header.nsizes = matrix->nsizes;
+        header.host_size = host_size;
+
+        MPI_CHECK(MPI_File_write_at(file, 0, &header, sizeof(header),
+                                    MPI_BYTE, MPI_STATUS_IGNORE));
+        char *hosts = calloc(matrix->nranks, host_size);
+
+        assert(hosts);
+        for (int rank = 0; rank < matrix->nranks; rank++)
+            strcpy(hosts + rank * host_size, get_hostname(rank, true));
+        MPI_CHECK(MPI_File_write_at(file, hosts_off, hosts,
+                                    host_size * matrix->nranks,
+                                    MPI_BYTE, MPI_STATUS_IGNORE));
+        free(hosts);
+        MPI_CHECK(MPI_File_write_at(file, sizes_off, matrix->sizes,
+                                    matrix->nsizes, MPI_UINT64_T,
+                                    MPI_STATUS_IGNORE));
+    }
+
+    /* The column of the current rank is made of one float every 'nranks'
+     * floats, through all the matrices */
+    MPI_CHECK(MPI_Type_vector(matrix->nsizes * matrix->nranks, 1,
+                              matrix->nranks, MPI_FLOAT, &column_type));
+    MPI_CHECK(MPI_Type_commit(&column_type));
+    MPI_CHECK(MPI_File_set_view(file,
+                                data_off + sizeof(float) * client_rank,
+                                MPI_FLOAT, column_type, "native",
+                                MPI_INFO_NULL));
+    MPI_CHECK(MPI_File_write_all(file, matrix->bw,
+                                 matrix->nsizes * matrix->nranks, MPI_FLOAT,
+                                 MPI_STATUS_IGNORE));
+    MPI_CHECK(MPI_Type_free(&column_type));
+    MPI_CHECK(MPI_File_close(&file));
+
+    if (my.matrix_export == MATRIX_EXPORT_NONE ||
+        client_rank != MPI_ROOT_RANK)
+        return;
+
+    snprintf(path, sizeof(path), "%s.%s", prefix,
+             matrix_export_str[my.matrix_export]);
+    FILE *stream = fopen(path, "w");
+    if (stream == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return;
+    }
+
+    if (my.matrix_export == MATRIX_EXPORT_CSV)
+        write_matrix_csv(stream, matrix, all_bw);
+    else
+        write_matrix_json(stream, matrix, all_bw);
+
+    fclose(stream);
+}
+
+/* Flows taken into account by the analysis: the ones that were tested, and
+ * not between two ranks of the same node when those are reported apart */
+static bool analyze_flow(const struct pair_matrix *matrix,
+                         const float *all_bw, int s, int src, int dst)
+{
+    if (src == dst || matrix_get(matrix, all_bw, s, src, dst) <= 0)
+        return false;
+
+    return my.intra_mode != INTRA_SEPARATE ||
+           my.node_ids[src] != my.node_ids[dst];
+}
+
+/* The analysis works on nodes, as a slow node is slow for all its ranks, or
+ * on ranks when they all share a single node */
+static inline int analyze_group(int rank)
+{
+    return my.nnodes > 1 ? my.node_ids[rank] : rank;
+}
+
+static inline const char *analyze_group_name(int group, int rank)
+{
+    return my.nnodes > 1 ? my.nodes[group] : get_hostname(rank, true);
+}
+
+/* Median of the flows of group 'g' with the other groups in one direction,
+ * for size index 's' */
+static float group_median(const struct pair_matrix *matrix,
+                          const float *all_bw, int s, int g, bool tx,
+                          float *flows)
+{
+    int count = 0;
+
+    for (int r = 0; r < matrix->nranks; r++)
+    {
+        if (analyze_group(r) != g)
+            continue;
+
+        for (int peer = 0; peer < matrix->nranks; peer++)
+        {
+            const int src = tx ? r : peer;
+            const int dst = tx ? peer : r;
+
+            if (analyze_group(peer) != g &&
+                analyze_flow(matrix, all_bw, s, src, dst))
+                flows[count++] = matrix_get(matrix, all_bw, s, src, dst);
+        }
+    }
+
+    return count ? median(flows, count) : NAN;
+}
+
+/* Print the statistics of a size before its first outlier */
+static void outlier_header(FILE *stream, const struct pair_matrix *matrix,
+                           int s, float med, float mad, bool *header)
+{
+    if (!*header)
+        fprintf(stream, "# size %"PRIu64": median %.0f MB/s, MAD %.0f MB/s\n",
+                matrix->sizes[s], med, mad);
+    *header = true;
+}
+
+/* Look for slow nodes and slow links, size by size. A node is slow with
+ * everyone when the median of its flows with the other nodes in one
+ * direction (tx or rx) is an outlier among the medians of all the nodes in
+ * that direction. A link is slow when its flow is an outlier among all the
+ * flows, while neither its source nor its destination node is slow */
+static void analyze_matrix(const struct pair_matrix *matrix,
+                           const float *all_bw, FILE *stream)
+{
+    const int nranks = matrix->nranks;
+    const int ngroups = my.nnodes > 1 ? my.nnodes : nranks;
+    float *values = malloc(sizeof(float) * nranks * nranks);
+    float *tx_med = malloc(sizeof(float) * ngroups);
+    float *rx_med = malloc(sizeof(float) * ngroups);
+    int *group_rank = malloc(sizeof(int) * ngroups);
+    bool *slow_tx = malloc(sizeof(bool) * ngroups);
+    bool *slow_rx = malloc(sizeof(bool) * ngroups);
+    int noutliers = 0;
+
+    assert(values && tx_med && rx_med && group_rank && slow_tx && slow_rx);
+
+    /* First rank of every group, which names it */
+    for (int r = nranks - 1; r >= 0; r--)
+        group_rank[analyze_group(r)] = r;
+
+    fprintf(stream, "\n# Outliers (below the median by more than %.1f MADs "
+                    "and %.0f%%)\n", OUTLIER_NMADS, OUTLIER_MIN_DROP * 100);
+
+    for (int s = 0; s < matrix->nsizes; s++)
+    {
+        float med, mad, tx_all, tx_mad, rx_all, rx_mad;
+        int count = 0;
+        bool header = false;
+
+        for (int src = 0; src < nranks; src++)
+            for (int dst = 0; dst < nranks; dst++)
+                if (analyze_flow(matrix, all_bw, s, src, dst))
+                    values[count++] = matrix_get(matrix, all_bw, s, src, dst);
+
+        /* Not enough flows for the statistics to mean anything */
+        if (count < 3)
+            continue;
+
+        median_mad(values, count, &med, &mad);
+
+        /* Groups without any flow in a direction (NAN) are left out. The
+         * flows of a group fit in 'values', which is only filled with the
+         * medians once they are all known */
+        for (int dir = 0; dir < 2; dir++)
+        {
+            float *group_med = dir ? rx_med : tx_med;
+            bool *slow = dir ? slow_rx : slow_tx;
+            float *all = dir ? &rx_all : &tx_all;
+            float *all_mad = dir ? &rx_mad : &tx_mad;
+
+            for (int g = 0; g < ngroups; g++)
+                group_med[g] = group_median(matrix, all_bw, s, g, !dir,
+                                            values);
+            count = 0;
+            for (int g = 0; g < ngroups; g++)
+                if (!isnan(group_med[g]))
+                    values[count++] = group_med[g];
+            median_mad(values, count, all, all_mad);
+
+            for (int g = 0; g < ngroups; g++)
+                slow[g] = !isnan(group_med[g]) &&
+                          is_outlier(group_med[g], *all, *all_mad);
+        }
+
+        for (int g = 0; g < ngroups; g++)
+        {
+            const char *name = analyze_group_name(g, group_rank[g]);
+            const char *kind = my.nnodes > 1 ? "node" : "rank";
+
+            if (slow_tx[g])
+            {
+                outlier_header(stream, matrix, s, med, mad, &header);
+                fprintf(stream, "#   slow %s %s: tx %.0f MB/s (%+.0f%%)\n",
+                        kind, name, tx_med[g],
+                        100 * (tx_med[g] - tx_all) / tx_all);
+                noutliers++;
+            }
+            if (slow_rx[g])
+            {
+                outlier_header(stream, matrix, s, med, mad, &header);
+                fprintf(stream, "#   slow %s %s: rx %.0f MB/s (%+.0f%%)\n",
+                        kind, name, rx_med[g],
+                        100 * (rx_med[g] - rx_all) / rx_all);
+                noutliers++;
+            }
+        }
+
+        for (int src = 0; src < nranks; src++)
+        {
+            for (int dst = 0; dst < nranks; dst++)
+            {
+                float bw = matrix_get(matrix, all_bw, s, src, dst);
+
+                if (!analyze_flow(matrix, all_bw, s, src, dst) ||
+                    slow_tx[analyze_group(src)] ||
+                    slow_rx[analyze_group(dst)] ||
+                    !is_outlier(bw, med, mad))
+                    continue;
+
+                outlier_header(stream, matrix, s, med, mad, &header);
+                fprintf(stream, "#   slow link %s -> %s: %.0f MB/s (%+.0f%%)\n",
+                        get_hostname(src, true), get_hostname(dst, true),
+                        bw, 100 * (bw - med) / med);
+                noutliers++;
+            }
+        }
+    }
+
+    if (noutliers == 0)
+        fprintf(stream, "# None\n");
+
+    free(values);
+    free(tx_med);
+    free(rx_med);
+    free(group_rank);
+    free(slow_tx);
+    free(slow_rx);
+}
+
+/* Every node of the matrix: the median of the flows to or from its ranks,
+ * leaving the intra-node ones out of multi-node runs. The flows themselves
+ * are left to the matrix files, as N x N records per size would not fit in
+ * the baseline of a large run */
+static void record_matrix(const struct pair_matrix *matrix,
+                          const float *all_bw)
+{
+    const int n = matrix->nranks;
+    int *node_size = calloc(my.nnodes, sizeof(int));
+    int max_node_size = 0;
+    float *values;
+    struct result_record rec = {
+        .type = "node", .table = "all-to-all", .dir = "Und",
+    };
+
+    assert(node_size);
+    for (int rank = 0; rank < n; rank++)
+        max_node_size = MAX(max_node_size, ++node_size[my.node_ids[rank]]);
+    values = malloc(sizeof(float) * 2 * n * max_node_size);
+    assert(values);
+
+    for (int s = 0; s < matrix->nsizes; s++)
+    {
+        rec.size = matrix->sizes[s];
+
+        for (int node = 0; node < my.nnodes; node++)
+        {
+            int count = 0;
+
+            for (int rank = 0; rank < n; rank++)
+            {
+                if (my.node_ids[rank] != node)
+                    continue;
+                if (count == 0)
+                    node_name(rank, rec.src);
+
+                /* The flows within a single node are only counted once,
+                 * on their receiving side */
+                for (int peer = 0; peer < n; peer++)
+                {
+                    const bool intra = my.node_ids[peer] == node;
+                    const float rx = matrix_get(matrix, all_bw, s, peer, rank);
+                    const float tx = matrix_get(matrix, all_bw, s, rank, peer);
+
+                    if (rx > 0 && (!intra || my.nnodes == 1))
+                        values[count++] = rx;
+                    if (tx > 0 && !intra)
+                        values[count++] = tx;
+                }
+            }
+            if (count == 0)
+                continue;
+
+            rec.count = count;
+            rec.bw_mbs = median(values, count);
+            results_record(&rec);
+        }
+    }
+    free(values);
+    free(node_size);
+}
+
+static void batch_alltoall(struct test_config *config, void *arg)
+{
+    struct step_times *total_times = arg;
+    struct step_times times[_LINK_LAST];
+
+    run_test_alltoall(config, times);
+    for (int c = 0; c < _LINK_LAST; c++)
+    {
+        total_times[c].tx  += times[c].tx;
+        total_times[c].rx  += times[c].rx;
+        total_times[c].all += times[c].all;
+    }
+}
+
+/* Run the current size, for a fixed number of iterations or within the time
+ * budget */
+static void run_alltoall_size(struct test_config *config,
+                              struct step_times times[_LINK_LAST])
+{
+    /* The flows of the matrix add up over the batches of the size */
+    reset_pair_flows(config);
+
+    if (my.time_per_size > 0)
+    {
+        struct step_times probe_times[_LINK_LAST];
+
+        memset(times, 0, sizeof(struct step_times) * _LINK_LAST);
+        memset(probe_times, 0, sizeof(probe_times));
+        run_calibrated(config, batch_alltoall, probe_times, times);
+    }
+    else
+        run_test_alltoall(config, times);
+}
+
+/* Report the results of one link class for the current size */
+static void report_alltoall(const struct test_config *config,
+                            int npeers,
+                            const struct step_times *times,
+                            const struct histogram *hist,
+                            const char *table, FILE *stream)
+{
+    struct results res;
+
+    if (my.bidirectional && !alltoall_is_rma(config))
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            struct test_config row;
+
+            generate_results_bidi(config, npeers, times,
+                                  bidi_rows[r], &row, &res);
+            /* Latencies cover both directions */
+            print_results_reduced(&row, &res,
+                                  bidi_rows[r] == DIR_BIDI ? hist : NULL,
+                                  table, stream);
+        }
+    }
+    else
+    {
+        generate_results(config, npeers, times->all, &res);
+        print_results_reduced(config, &res, hist, table, stream);
+    }
+}
+
+/* Burn-in / monitoring mode: the pattern runs over and over with a single
+ * size. Every interval is reduced with non-blocking collectives while the
+ * next one runs, and printed one interval late. Each rank also keeps the
+ * bandwidth of the flows it receives for the last MONITOR_RING_SIZE
+ * intervals, which make the per-link time series of the end of the run */
+#define MONITOR_RING_SIZE 1024
+
+/* Per-link samples of the last intervals, the oldest ones being overwritten */
+struct monitor_ring
+{
+    int count;         /* Intervals recorded since the beginning */
+    int64_t *starts;   /* Wall clock time of every interval */
+    float *bw;         /* MONITOR_RING_SIZE x nranks, mean MB/s per source */
+    uint32_t *errors;  /* MONITOR_RING_SIZE x nranks, per source */
+};
+
+/* Statistics of an interval, in flight while the next one runs */
+struct monitor_report
+{
+    bool pending;
+    int index;
+    int npasses;
+    int64_t start;
+    struct results_reduced res;
+    struct results_reduced res_out;
+    struct histogram hist;
+    struct histogram hist_out;
+    uint64_t verify[2];       /* Checked and corrupted messages */
+    uint64_t verify_out[2];
+    MPI_Request reqs[3];
+};
+
+#define MONITOR_PRINT_HEADER                                                   \
+    "interval            time(UTC) passes"
+
+#define MONITOR_PRINT_FMT                                                      \
+    "%8d %20s %6d"
+
+static void monitor_ring_alloc(struct monitor_ring *ring)
+{
+    const size_t nvalues = (size_t) MONITOR_RING_SIZE * my.glob_size;
+
+    ring->count = 0;
+    ring->starts = malloc(sizeof(*ring->starts) * MONITOR_RING_SIZE);
+    ring->bw = malloc(sizeof(*ring->bw) * nvalues);
+    ring->errors = malloc(sizeof(*ring->errors) * nvalues);
+    assert(ring->starts && ring->bw && ring->errors);
+}
+
+static void monitor_ring_free(struct monitor_ring *ring)
+{
+    free(ring->starts);
+    free(ring->bw);
+    free(ring->errors);
+}
+
+/* Start a new interval in the ring, and return its slot */
+static int monitor_ring_next(struct monitor_ring *ring)
+{
+    const int slot = ring->count++ % MONITOR_RING_SIZE;
+
+    ring->starts[slot] = time(NULL);
+    memset(&ring->bw[(size_t) slot * my.glob_size], 0,
+           sizeof(*ring->bw) * my.glob_size);
+    memset(&ring->errors[(size_t) slot * my.glob_size], 0,
+           sizeof(*ring->errors) * my.glob_size);
+    return slot;
+}
+
+static void format_utc(int64_t stamp, char *buf, size_t size)
+{
+    const time_t t = stamp;
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static void monitor_print_header(FILE *stream)
+{
+    if (my.glob_rank != MPI_ROOT_RANK)
+        return;
+
+    fprintf(stream, "                                                                       SUM                                     MIN                                      MAX                                     LATENCY PERCENTILES          \n");
+    fprintf(stream, MONITOR_PRINT_HEADER" "
+                    CONFIG_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    RESULTS_PRINT_HEADER" "
+                    HIST_PRINT_HEADER"%s\n",
+                    my.verify ? "   corrupted" : "");
+}
+
+/* Start the reductions of an interval. Its histogram and its results are
+ * copied, so that the next interval can run meanwhile */
+static void monitor_post_report(struct monitor_report *report,
+                                const struct test_config *config,
+                                int npeers,
+                                const struct step_times *times)
+{
+    struct results res;
+
+    generate_results(config, npeers * report->npasses, times->all, &res);
+    results_reduced_init(&res, &report->res);
+    report->hist = config->hist[LINK_INTER];
+    report->verify[0] = config->verify ? config->verify->checked : 0;
+    report->verify[1] = 0;
+    for (int r = 0; r < my.glob_size && config->verify; r++)
+        report->verify[1] += config->verify->errors[r];
+
+    MPI_CHECK(MPI_Ireduce(&report->res, &report->res_out, 1, reduced_dtype,
+                          reduced_op, MPI_ROOT_RANK, clients_comm,
+                          &report->reqs[0]));
+    MPI_CHECK(MPI_Ireduce(&report->hist, &report->hist_out, 1, hist_dtype,
+                          hist_op, MPI_ROOT_RANK, clients_comm,
+                          &report->reqs[1]));
+    MPI_CHECK(MPI_Ireduce(report->verify, report->verify_out, 2,
+                          MPI_UINT64_T, MPI_SUM, MPI_ROOT_RANK, clients_comm,
+                          &report->reqs[2]));
+    report->pending = true;
+}
+
+/* Complete the reductions of an interval and print it */
+static void monitor_complete_report(struct monitor_report *report,
+                                    const struct test_config *config,
+                                    FILE *stream)
+{
+    char start[32];
+
+    MPI_CHECK(MPI_Waitall(3, report->reqs, MPI_STATUSES_IGNORE));
+    report->pending = false;
+
+    if (my.glob_rank != MPI_ROOT_RANK)
+        return;
+
+    my.verified += report->verify_out[0];
+    my.corrupted += report->verify_out[1];
+
+    format_utc(report->start, start, sizeof(start));
+    fprintf(stream, MONITOR_PRINT_FMT" "
+                    CONFIG_PRINT_FMT" "
+                    RESULTS_PRINT_FMT" "
+                    RESULTS_PRINT_FMT" "
+                    RESULTS_PRINT_FMT" "
+                    HIST_PRINT_FMT,
+                    report->index, start, report->npasses,
+                    CONFIG_PRINT_ARGS(config),
+                    RESULTS_PRINT_ARGS(&report->res_out.sum),
+                    RESULTS_PRINT_ARGS(&report->res_out.min),
+                    RESULTS_PRINT_ARGS(&report->res_out.max),
+                    HIST_PRINT_ARGS(&report->hist_out));
+    if (my.verify)
+        fprintf(stream, " %11"PRIu64, report->verify_out[1]);
+    fprintf(stream, "\n");
+    fflush(stream);
+}
+
+/* Write the time series of every link, as CSV. The file is written with
+ * MPI-IO, one interval at a time: every rank formats the flows it received
+ * during the interval and writes them right after the ones of the lower
+ * ranks, so that the root never holds more than its own ring */
+static void monitor_write_series(const struct monitor_ring *ring,
+                                 const char *path)
+{
+    const char *header = "time,src,dst,bw(MB/s),corrupted\n";
+    const int first = MAX(ring->count - MONITOR_RING_SIZE, 0);
+    MPI_Offset offset = strlen(header);
+    MPI_File file;
+
+    if (MPI_File_open(MPI_COMM_WORLD, path,
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        if (my.glob_rank == MPI_ROOT_RANK)
+            fprintf(stderr, "Cannot open %s\n", path);
+        return;
+    }
+    MPI_CHECK(MPI_File_set_size(file, 0));
+
+    if (my.glob_rank == MPI_ROOT_RANK)
+        MPI_CHECK(MPI_File_write_at(file, 0, header, strlen(header),
+                                    MPI_CHAR, MPI_STATUS_IGNORE));
+
+    for (int i = first; i < ring->count; i++)
+    {
+        const int slot = i % MONITOR_RING_SIZE;
+        MPI_Offset size, before = 0, total;
+        char start[32], *lines = NULL;
+        size_t len = 0;
+        FILE *stream = open_memstream(&lines, &len);
+
+        assert(stream);
+        format_utc(ring->starts[slot], start, sizeof(start));
+        for (int src = 0; src < my.glob_size; src++)
+        {
+            const size_t idx = (size_t) slot * my.glob_size + src;
+
+            if (ring->bw[idx] == 0 && ring->errors[idx] == 0)
+                continue;
+
+            fprintf(stream, "%s,%s,%s,%.1f,%"PRIu32"\n", start,
+                    get_hostname(src, false),
+                    get_hostname(my.glob_rank, false),
+                    ring->bw[idx], ring->errors[idx]);
+        }
+        fclose(stream);
+
+        assert(len <= INT_MAX);
+        size = len;
+        MPI_CHECK(MPI_Exscan(&size, &before, 1, MPI_OFFSET, MPI_SUM,
+                             MPI_COMM_WORLD));
+        /* The result of MPI_Exscan is undefined on the first rank */
+        if (my.glob_rank == 0)
+            before = 0;
+        MPI_CHECK(MPI_Allreduce(&size, &total, 1, MPI_OFFSET, MPI_SUM,
+                                MPI_COMM_WORLD));
+
+        MPI_CHECK(MPI_File_write_at_all(file, offset + before, lines, len,
+                                        MPI_CHAR, MPI_STATUS_IGNORE));
+        offset += total;
+        free(lines);
+    }
+
+    MPI_CHECK(MPI_File_close(&file));
+}
+
+/* State of the monitoring after a pass, agreed on by all the ranks as they
+ * all run the same passes */
+enum monitor_state
+{
+    MONITOR_RUN = 0,   /* Keep running the interval */
+    MONITOR_NEXT,      /* The interval is over */
+    MONITOR_END,       /* The whole run is over */
+};
+
+/* Run the monitoring mode, with the buffers of the all-to-all test. Every
+ * interval runs passes of the pattern until it lasted --interval seconds,
+ * and the run until it lasted --monitor seconds, the last interval being
+ * cut short if needed */
+static void monitor_alltoall(struct test_config *config, int npeers)
+{
+    struct monitor_ring ring;
+    struct monitor_report reports[2] = { { 0 } };
+    struct step_times times[_LINK_LAST];
+    float *pass_bw = malloc(sizeof(float) * my.glob_size);
+    enum monitor_state state = MONITOR_RUN;
+    double run_start;
+    int i;
+
+    assert(pass_bw);
+    monitor_ring_alloc(&ring);
+
+    init_test(TEST_MODE_ALL_TO_ALL, 0, my.niters, my.nflight, my.sizes[0],
+              DIR_NONE, config);
+    config->pair_bw = pass_bw;
+
+    /* A first pass sets the connections up, out of the intervals */
+    memset(times, 0, sizeof(times));
+    batch_alltoall(config, times);
+
+    monitor_print_header(stdout);
+    run_start = MPI_Wtime();
+
+    for (i = 0; state != MONITOR_END; i++)
+    {
+        struct monitor_report *report = &reports[i % 2];
+        struct monitor_report *prev = &reports[(i + 1) % 2];
+        const int slot = monitor_ring_next(&ring);
+        float *bw = &ring.bw[(size_t) slot * my.glob_size];
+        int npasses = 0;
+        double start;
+
+        /* The clocks keep drifting apart during a long run */
+        if (my.clock_sync)
+            clock_sync();
+        start = MPI_Wtime();
+
+        init_test(TEST_MODE_ALL_TO_ALL, i, my.niters, my.nflight,
+                  my.sizes[0], DIR_NONE, config);
+        memset(times, 0, sizeof(times));
+
+        do
+        {
+            double now;
+            int done;
+
+            memset(pass_bw, 0, sizeof(float) * my.glob_size);
+            reset_pair_flows(config);
+            batch_alltoall(config, times);
+            for (int r = 0; r < my.glob_size; r++)
+                bw[r] += pass_bw[r];
+            npasses++;
+
+            /* Give the reductions of the previous interval a chance to
+             * progress */
+            if (prev->pending)
+                MPI_CHECK(MPI_Testall(3, prev->reqs, &done,
+                                      MPI_STATUSES_IGNORE));
+
+            now = MPI_Wtime();
+            state = now - run_start >= my.monitor ? MONITOR_END :
+                    now - start >= my.interval ? MONITOR_NEXT : MONITOR_RUN;
+            MPI_CHECK(MPI_Allreduce(MPI_IN_PLACE, &state, 1, MPI_INT,
+                                    MPI_MAX, clients_comm));
+        } while (state == MONITOR_RUN);
+
+        for (int r = 0; r < my.glob_size; r++)
+            bw[r] /= npasses;
+        for (int r = 0; r < my.glob_size && config->verify; r++)
+            ring.errors[(size_t) slot * my.glob_size + r] =
+                config->verify->errors[r];
+
+        if (prev->pending)
+            monitor_complete_report(prev, config, stdout);
+
+        report->index = i;
+        report->start = ring.starts[slot];
+        report->npasses = npasses;
+        monitor_post_report(report, config, npeers, &times[LINK_INTER]);
+    }
+
+    monitor_complete_report(&reports[(i - 1) % 2], config, stdout);
+
+    if (my.series_path)
+        monitor_write_series(&ring, my.series_path);
+
+    config->pair_bw = NULL;
+    monitor_ring_free(&ring);
+    free(pass_bw);
+}
+
+/* Drop the peers which are on the same node as the current rank */
+static void skip_intra_node_peers(struct peer_entry *peers_list, int count)
+{
+    for (int i = 0; i < count; i++)
+        if (peers_list[i].rank != MPI_PROC_NULL &&
+            my.node_ids[peers_list[i].rank] == my.node_ids[my.glob_rank])
+            peers_list[i].rank = MPI_PROC_NULL;
+}
+
+/* Memory of the node of the current rank, shared evenly between its ranks,
+ * 0 when unknown */
+static double node_memory_per_rank(void)
+{
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page = sysconf(_SC_PAGESIZE);
+    int nlocal = 0;
+
+    if (pages <= 0 || page <= 0)
+        return 0;
+
+    for (int rank = 0; rank < my.glob_size; rank++)
+        nlocal += my.node_ids[rank] == my.node_ids[my.glob_rank];
+
+    return (double) pages * page / MAX(nlocal, 1);
+}
+
+/* Whether the buffers of every rank fit in the memory of its node. Incast
+ * and broadcast need nranks x nflight receive regions on their root, which
+ * are not capped with --verify or --clock-sync */
+static bool alltoall_buffers_fit(double bytes)
+{
+    const double avail = node_memory_per_rank();
+    double need[2] = { bytes, avail > 0 ? bytes / avail : 0 };
+
+    MPI_CHECK(MPI_Allreduce(MPI_IN_PLACE, need, 2, MPI_DOUBLE, MPI_MAX,
+                            clients_comm));
+    if (need[1] <= 1)
+        return true;
+
+    if (my.glob_rank == MPI_ROOT_RANK)
+        fprintf(stderr, "The all-to-all buffers need up to %.0f MiB per "
+                        "rank, more than the memory of its node: use a "
+                        "smaller --nflight or --sizes%s\n",
+                need[0] / (1024 * 1024),
+                my.verify || my.clock_sync ?
+                " (the receive buffers are not capped with --verify or "
+                "--clock-sync)" : "");
+    return false;
+}
+
+/* Returns false when the buffers of the test do not fit in memory */
+static bool test_alltoall(void)
+{
+    const size_t end_size = max_size();
+    int curr_iter = 0;
+    struct test_config test_config;
+    struct step_times times[_LINK_LAST];
+    int npeers[_LINK_LAST] = { 0 };
+    const enum direction rma_dirs[2] = { DIR_PUT, DIR_GET };
+    int rma_npeers[2][_LINK_LAST] = { { 0 } };
+    size_t send_regions;
+    char *intra_table = NULL;
+    size_t intra_table_size = 0;
+    FILE *intra_stream = NULL;
+    struct pair_matrix matrix = { 0 };
+
+    test_config.pair_bw = NULL;
+    test_config.flows = alloc_pair_flows();
+    test_config.verify = alloc_verify_stats();
+    test_config.one_way = alloc_one_way_stats();
+    test_config.data_type = MPI_CHAR;
+    test_config.peers_list = pattern_get_peers(my.pattern,
+                                               my.glob_rank, my.nclients,
+                                               &test_config.nsteps,
+                                               &test_config.step_width);
+    assert(test_config.peers_list);
+    test_config.peers_list = pattern_merge_steps(test_config.peers_list,
+                                                 my.fanout,
+                                                 &test_config.nsteps,
+                                                 &test_config.step_width);
+    assert(test_config.peers_list);
+    if (my.intra_mode == INTRA_SKIP)
+        skip_intra_node_peers(test_config.peers_list,
+                              test_config.nsteps * test_config.step_width);
+#if 0
+    alltoall_print_peers(test_config.peers_list,
+                         test_config.nsteps, test_config.step_width);
+#endif
+
+    /* Count the flows of the current rank over all the steps, and the ones
+     * it initiates in one-sided mode */
+    for (int i = 0; i < test_config.nsteps * test_config.step_width; i++)
+    {
+        const struct peer_entry *entry = &test_config.peers_list[i];
+
+        if (entry->rank == MPI_PROC_NULL)
+            continue;
+
+        npeers[get_link_class(entry->rank)]++;
+        for (int d = 0; d < 2; d++)
+            if (rma_is_initiator(rma_dirs[d], entry->role))
+                rma_npeers[d][get_link_class(entry->rank)]++;
+    }
+
+    /* Allocate buffers. Receive buffers are not shared between the peers of
+     * a step, up to ALLTOALL_RECV_MAX bytes: incast and broadcast would need
+     * nranks x nflight regions. The messages of the peers then overlap, which
+     * the payload checks and the one-way stamps can not afford. Checked Puts
+     * carry the rank of their target, so they do not share the send slots
+     * either */
+    test_config.recv_regions = (size_t) my.nflight * test_config.step_width;
+    if (!my.verify && !my.clock_sync &&
+        test_config.recv_regions * end_size > ALLTOALL_RECV_MAX)
+        test_config.recv_regions = MAX(1, ALLTOALL_RECV_MAX / end_size);
+    send_regions = (size_t) my.nflight *
+                   (my.verify && my.alltoall_rma ? test_config.step_width : 1);
+    if (!alltoall_buffers_fit((double) end_size *
+                              (send_regions + test_config.recv_regions *
+                               (my.alltoall_rma ? 2 : 1))))
+    {
+        free_pair_flows(test_config.flows);
+        free(test_config.peers_list);
+        free_verify_stats(test_config.verify);
+        free_one_way_stats(test_config.one_way);
+        return false;
+    }
+    test_config.s_buffer = allocate_buffer(end_size * send_regions);
+    test_config.r_buffer = allocate_buffer(end_size *
+                                           test_config.recv_regions);
+    test_config.hist = mallocz(sizeof(struct histogram) * _LINK_LAST);
+    assert(test_config.hist);
+    test_config.scratch = alloc_step_scratch(test_config.step_width,
+                                             my.nflight);
+
+    if (my.matrix_prefix || my.analyze)
+        alloc_matrix(&matrix);
+
+    /* Every rank exposes one region per (entry, slot) to the one-sided
+     * operations of its peers, for the whole sweep */
+    if (my.alltoall_rma)
+    {
+        const size_t win_size = end_size * test_config.recv_regions;
+
+        test_config.rdma_buffer = allocate_buffer(win_size);
+        MPI_CHECK(MPI_Win_create(test_config.rdma_buffer, win_size,
+                                 1, MPI_INFO_NULL, clients_comm,
+                                 &test_config.rdma_win));
+        MPI_CHECK(MPI_Win_lock_all(MPI_MODE_NOCHECK, test_config.rdma_win));
+    }
+
+    if (my.sequential_ios)
+        MPI_CHECK(MPI_Comm_dup(clients_comm, &seq_comm));
+
+    /* Warmup test */
+    init_test(TEST_MODE_ALL_TO_ALL,
+              -1, 2, my.nflight, end_size, DIR_NONE, &test_config);
+    run_test_alltoall(&test_config, times);
+    for (int d = 0; d < 2 && my.alltoall_rma; d++)
+    {
+        init_test(TEST_MODE_ALL_TO_ALL,
+                  -1, 2, my.nflight, end_size, rma_dirs[d], &test_config);
+        run_test_alltoall(&test_config, times);
+    }
+
+    if (my.monitor > 0)
+        monitor_alltoall(&test_config, npeers[LINK_INTER]);
+    else if (my.output_mode == OUTPUT_MPI)
+    {
+        print_header_reduced(stdout);
+
+        /* The intra-node table is printed once the sweep is over */
+        if (my.intra_mode == INTRA_SEPARATE)
+        {
+            int client_rank;
+
+            intra_stream = open_memstream(&intra_table, &intra_table_size);
+            assert(intra_stream);
+
+            MPI_CHECK(MPI_Comm_rank(clients_comm, &client_rank));
+            if (client_rank == MPI_ROOT_RANK)
+                fprintf(intra_stream, "\n# Intra-node links\n");
+            print_header_reduced(intra_stream);
+        }
+    }
+
+    for (int s = 0; s < my.nsizes && my.monitor == 0; s++)
+    {
+        if (my.clock_sync)
+            clock_sync();
+
+        init_test(TEST_MODE_ALL_TO_ALL,
+                  curr_iter++,
+                  my.niters, my.nflight, my.sizes[s],
+                  DIR_NONE,
+                  &test_config);
+        if (matrix.bw)
+            test_config.pair_bw = &matrix.bw[(size_t) (curr_iter - 1) *
+                                             matrix.nranks];
+
+        run_alltoall_size(&test_config, times);
+
+        if (my.output_mode == OUTPUT_MPI)
+        {
+            report_alltoall(&test_config, npeers[LINK_INTER],
+                            &times[LINK_INTER], &test_config.hist[LINK_INTER],
+                            "all-to-all", stdout);
+            if (my.intra_mode == INTRA_SEPARATE)
+                report_alltoall(&test_config, npeers[LINK_INTRA],
+                                &times[LINK_INTRA],
+                                &test_config.hist[LINK_INTRA], "intra-node",
+                                intra_stream);
+        }
+
+        if (test_config.verify)
+            report_verify(&test_config, stdout);
+        if (test_config.one_way)
+            report_clock(&test_config, stdout);
+
+        /* One-sided flavor of the same size, printed right below */
+        for (int d = 0; d < 2 && my.alltoall_rma; d++)
+        {
+            const enum direction direction = rma_dirs[d];
+
+            init_test(TEST_MODE_ALL_TO_ALL,
+                      curr_iter - 1,
+                      my.niters, my.nflight, my.sizes[s],
+                      direction,
+                      &test_config);
+            test_config.pair_bw = NULL;
+
+            run_alltoall_size(&test_config, times);
+
+            if (test_config.verify)
+                report_verify(&test_config, stdout);
+            if (test_config.one_way)
+                report_clock(&test_config, stdout);
+
+            if (my.output_mode != OUTPUT_MPI)
+                continue;
+
+            report_alltoall(&test_config, rma_npeers[d][LINK_INTER],
+                            &times[LINK_INTER], &test_config.hist[LINK_INTER],
+                            "all-to-all", stdout);
+            if (my.intra_mode == INTRA_SEPARATE)
+                report_alltoall(&test_config, rma_npeers[d][LINK_INTRA],
+                                &times[LINK_INTRA],
+                                &test_config.hist[LINK_INTRA], "intra-node",
+                                intra_stream);
+        }
+    }
+    flush_results_reduced();
+
+    if (intra_stream)
+    {
+        fclose(intra_stream);
+        fputs(intra_table, stdout);
+        free(intra_table);
+    }
+
+    if (matrix.bw)
+    {
+        /* The binary file is written by every rank, only the analysis and
+         * the exports need the whole matrix on the root */
+        float *all_bw = NULL;
+
+        if (my.analyze || my.matrix_export != MATRIX_EXPORT_NONE ||
+            results_enabled())
+            all_bw = gather_matrix(&matrix);
+
+        if (my.matrix_prefix)
+            write_matrix(&matrix, all_bw, my.matrix_prefix);
+        if (my.analyze && all_bw)
+            analyze_matrix(&matrix, all_bw, stdout);
+        if (results_enabled() && all_bw)
+            record_matrix(&matrix, all_bw);
+
+        free(all_bw);
+        free_matrix(&matrix);
+    }
+
+    if (my.alltoall_rma)
+    {
+        MPI_CHECK(MPI_Win_unlock_all(test_config.rdma_win));
+        MPI_CHECK(MPI_Win_free(&test_config.rdma_win));
+        destroy_buffer(test_config.rdma_buffer);
+    }
+
+    if (my.sequential_ios)
+        MPI_CHECK(MPI_Comm_free(&seq_comm));
+
+    msg_type_free(&test_config.data_type);
+    destroy_buffer(test_config.s_buffer);
+    destroy_buffer(test_config.r_buffer);
+    free(test_config.hist);
+    free_step_scratch(test_config.scratch);
+    free_pair_flows(test_config.flows);
+    free(test_config.peers_list);
+    free_verify_stats(test_config.verify);
+    free_one_way_stats(test_config.one_way);
+    return true;
+}
+
+/* Link triage: instead of the N - 1 steps of a full pattern, a few coarse
+ * rounds where all the ranks are paired at once (a bisection, then random
+ * pairings, each one in both directions) look for the slow flows. The ranks
+ * at the ends of a slow flow are then tested against ranks that were never
+ * seen slow, which tells a bad rank, whose flows are slow in one direction
+ * whatever the peer, from a bad link. The slow flows between two healthy
+ * ranks are finally tested again on their own. A rank takes part in a
+ * single flow per round: its sends and receives share the same window, so
+ * a slow flow would slow down the other flow of its ends, and so on. The
+ * root of the clients decides every round: 'dst' holds the rank every rank
+ * sends to, or -1, and its last entry is 0 once done */
+#define TRIAGE_WIDTH    2 /* A send and a receive entry */
+#define TRIAGE_CONFIRMS 2 /* Tests of each suspect direction or link */
+
+enum triage_test
+{
+    TRIAGE_NONE,
+    TRIAGE_TX,   /* Suspect source, healthy destination */
+    TRIAGE_RX,   /* Healthy source, suspect destination */
+    TRIAGE_LINK, /* Slow flow tested again */
+};
+
+struct triage_flow
+{
+    int src;
+    int dst;
+    float bw;
+};
+
+/* Tests of a suspect direction of a rank, or of a suspect link */
+struct triage_tests
+{
+    bool suspect;
+    int ntests;
+    int nslow;
+    double bw; /* Sum of the bandwidths of the tests */
+};
+
+/* Run the round in 'dst', broadcast by the root. On the root, 'rx' gets the
+ * bandwidth received by every rank. Returns false once the root is done */
+static bool triage_round(struct test_config *config, int *dst, float *rx)
+{
+    struct peer_entry peers[TRIAGE_WIDTH] = {
+        { MPI_PROC_NULL, PEER_SEND }, { MPI_PROC_NULL, PEER_RECV },
+    };
+    float rx_bw = 0;
+
+    MPI_CHECK(MPI_Bcast(dst, my.nclients + 1, MPI_INT, MPI_ROOT_RANK,
+                        clients_comm));
+    if (dst[my.nclients] == 0)
+        return false;
+
+    if (dst[my.glob_rank] >= 0)
+        peers[0].rank = dst[my.glob_rank];
+    for (int src = 0; src < my.nclients; src++)
+        if (dst[src] == my.glob_rank)
+            peers[1].rank = src;
+
+    MPI_CHECK(MPI_Barrier(clients_comm));
+    run_test_alltoall_step(peers, config);
+
+    if (peers[1].rank != MPI_PROC_NULL)
+    {
+        struct results res;
+
+        generate_results(config, 1, config->scratch->times[1].rx, &res);
+        rx_bw = res.bw;
+    }
+
+    MPI_CHECK(MPI_Gather(&rx_bw, 1, MPI_FLOAT, rx, 1, MPI_FLOAT,
+                         MPI_ROOT_RANK, clients_comm));
+    return true;
+}
+
+/* Flows between two ranks of the same node say nothing about the fabric */
+static inline bool triage_counts(int src, int dst)
+{
+    return my.nnodes <= 1 || my.node_ids[src] != my.node_ids[dst];
+}
+
+static inline bool triage_pending(const struct triage_tests *t)
+{
+    return t->suspect && t->ntests < TRIAGE_CONFIRMS;
+}
+
+/* Most of the tests were slow */
+static inline bool triage_bad(const struct triage_tests *t)
+{
+    return t->ntests > 0 && 2 * t->nslow > t->ntests;
+}
+
+static inline bool triage_slow(float bw, float med)
+{
+    return bw < med * my.triage / 100;
+}
+
+static inline void triage_record(struct triage_tests *t, float bw, float med)
+{
+    t->ntests++;
+    t->nslow += triage_slow(bw, med);
+    t->bw += bw;
+}
+
+static void triage_shuffle(int *ranks, int count, uint64_t *state)
+{
+    for (int i = count - 1; i > 0; i--)
+    {
+        const int j = pattern_rand(state) % (i + 1);
+        const int tmp = ranks[i];
+
+        ranks[i] = ranks[j];
+        ranks[j] = tmp;
+    }
+}
+
+/* First healthy rank which is not part of the round yet and may be tested
+ * with 'rank', or -1 */
+static int triage_pick(const int *good, int ngood, const bool *used, int rank)
+{
+    for (int i = 0; i < ngood; i++)
+        if (!used[good[i]] && good[i] != rank && triage_counts(good[i], rank))
+            return good[i];
+    return -1;
+}
+
+/* Coarse round 'r': the first half of the ranks paired with the second
+ * half, then random pairings. Every pairing runs in both directions, over
+ * two rounds, the second one reusing 'order' */
+static void triage_coarse_round(int r, int *dst, int *order, uint64_t *state)
+{
+    const int n = my.nclients;
+
+    if (r % 2 == 0)
+    {
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        if (r > 0)
+            triage_shuffle(order, n, state);
+        else
+            for (int i = 0; i < n / 2; i++)
+            {
+                order[2 * i] = i;
+                order[2 * i + 1] = i + n / 2;
+            }
+    }
+
+    for (int i = 0; i < n; i++)
+        dst[i] = -1;
+    for (int i = 0; i + 1 < n; i += 2)
+    {
+        if (r % 2 == 0)
+            dst[order[i]] = order[i + 1];
+        else
+            dst[order[i + 1]] = order[i];
+    }
+}
+
+static void triage_root(struct test_config *config, int *dst, float *rx,
+                        FILE *stream)
+{
+    const int n = my.nclients;
+    const int ncoarse = 2 * MAX(1, (int) ceil(log2(n) / 2));
+    struct triage_flow *flows = malloc(sizeof(*flows) * ncoarse * n);
+    struct triage_tests *links = calloc((size_t) ncoarse * n, sizeof(*links));
+    struct triage_tests *tx = calloc(n, sizeof(*tx));
+    struct triage_tests *rxs = calloc(n, sizeof(*rxs));
+    float *values = malloc(sizeof(float) * ncoarse * n);
+    int *order = malloc(sizeof(int) * n);
+    int *good = malloc(sizeof(int) * n);
+    enum triage_test *tests = malloc(sizeof(*tests) * n);
+    int *link_of = malloc(sizeof(int) * n); /* Link tested by each source */
+    bool *used = malloc(sizeof(bool) * n); /* Part of the round already */
+    uint64_t state = ((uint64_t) my.seed << 32) + 1;
+    const double start = MPI_Wtime();
+    int nflows = 0, nslow = 0, ngood = 0, nrounds = 0, nfound = 0;
+    float med = 0;
+
+    assert(flows && links && tx && rxs && values && order && good &&
+           tests && link_of && used);
+
+    /* Coarse rounds, the first two being run once more beforehand to warm
+     * the connections up */
+    for (int r = -2; r < ncoarse; r++)
+    {
+        triage_coarse_round(r + 2 * (r < 0), dst, order, &state);
+        dst[n] = 1;
+        triage_round(config, dst, rx);
+        if (r < 0)
+            continue;
+        nrounds++;
+
+        for (int src = 0; src < n; src++)
+        {
+            if (dst[src] < 0 || !triage_counts(src, dst[src]))
+                continue;
+
+            flows[nflows].src = src;
+            flows[nflows].dst = dst[src];
+            flows[nflows].bw = rx[dst[src]];
+            values[nflows] = flows[nflows].bw;
+            nflows++;
+        }
+    }
+
+    med = median(values, nflows);
+    for (int f = 0; f < nflows; f++)
+    {
+        if (!triage_slow(flows[f].bw, med))
+            continue;
+
+        tx[flows[f].src].suspect = rxs[flows[f].dst].suspect = true;
+        links[f].suspect = true;
+        nslow++;
+    }
+
+    for (int i = 0; i < n; i++)
+        if (!tx[i].suspect && !rxs[i].suspect)
+            good[ngood++] = i;
+
+    /* Test the suspect directions against healthy ranks, as many at once as
+     * the ranks allow */
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (;;)
+        {
+            int nassigned = 0;
+
+            for (int i = 0; i < n; i++)
+            {
+                dst[i] = -1;
+                tests[i] = TRIAGE_NONE;
+                used[i] = false;
+            }
+            triage_shuffle(good, ngood, &state);
+
+            /* First the ranks, then the slow flows between healthy ends */
+            for (int s = 0; s < n && pass == 0; s++)
+            {
+                int g;
+
+                if (used[s])
+                    continue;
+
+                /* The transmit side first, the receive side in the next
+                 * rounds */
+                if (triage_pending(&tx[s]) &&
+                    (g = triage_pick(good, ngood, used, s)) >= 0)
+                {
+                    dst[s] = g;
+                    tests[s] = TRIAGE_TX;
+                    used[s] = used[g] = true;
+                    nassigned++;
+                }
+                else if (triage_pending(&rxs[s]) &&
+                         (g = triage_pick(good, ngood, used, s)) >= 0)
+                {
+                    dst[g] = s;
+                    tests[g] = TRIAGE_RX;
+                    used[g] = used[s] = true;
+                    nassigned++;
+                }
+            }
+
+            for (int f = 0; f < nflows && pass == 1; f++)
+            {
+                if (!triage_pending(&links[f]) ||
+                    used[flows[f].src] || used[flows[f].dst])
+                    continue;
+
+                dst[flows[f].src] = flows[f].dst;
+                tests[flows[f].src] = TRIAGE_LINK;
+                link_of[flows[f].src] = f;
+                used[flows[f].src] = used[flows[f].dst] = true;
+                nassigned++;
+            }
+
+            if (nassigned == 0)
+                break;
+
+            dst[n] = 1;
+            triage_round(config, dst, rx);
+            nrounds++;
+
+            for (int src = 0; src < n; src++)
+            {
+                if (tests[src] == TRIAGE_TX)
+                    triage_record(&tx[src], rx[dst[src]], med);
+                else if (tests[src] == TRIAGE_RX)
+                    triage_record(&rxs[dst[src]], rx[dst[src]], med);
+                else if (tests[src] == TRIAGE_LINK)
+                    triage_record(&links[link_of[src]], rx[dst[src]], med);
+            }
+        }
+
+        /* Only the slow flows between healthy ends are links to test, once
+         * per pair */
+        for (int f = 0; f < nflows && pass == 0; f++)
+        {
+            if (!links[f].suspect)
+                continue;
+
+            links[f].suspect = !triage_bad(&tx[flows[f].src]) &&
+                               !triage_bad(&rxs[flows[f].dst]);
+            for (int g = 0; g < f && links[f].suspect; g++)
+                links[f].suspect = !links[g].suspect ||
+                                   flows[g].src != flows[f].src ||
+                                   flows[g].dst != flows[f].dst;
+        }
+    }
+
+    dst[n] = 0;
+    triage_round(config, dst, rx);
 
-        exec_time = run_test_client_server(&test_config, &res);
+    fprintf(stream, "# Triage %zu: %d coarse rounds, %d flows, median %.0f "
+                    "MB/s, %d below %.0f MB/s\n", config->data_size,
+            ncoarse, nflows, med, nslow, med * my.triage / 100);
 
-        if (my.output_mode == OUTPUT_MPI)
+    for (int i = 0; i < n; i++)
+    {
+        for (int dir = 0; dir < 2; dir++)
         {
-            int npeers = my.glob_rank < my.nservers ? my.nclients : my.nservers;
-            generate_results(&test_config, npeers, exec_time, &res);
-            print_results_reduced(&test_config, &res);
+            const struct triage_tests *t = dir ? &rxs[i] : &tx[i];
+            const float bw = t->ntests ? t->bw / t->ntests : 0;
+
+            if (!t->suspect)
+                continue;
+
+            if (t->ntests == 0)
+                fprintf(stream, "#   undecided rank %s: %s, no healthy rank "
+                                "to test it with\n",
+                        get_hostname(i, true), dir ? "rx" : "tx");
+            else if (triage_bad(t))
+                fprintf(stream, "#   bad rank %s: %s %.0f MB/s (%+.0f%%)\n",
+                        get_hostname(i, true), dir ? "rx" : "tx", bw,
+                        100 * (bw - med) / med);
+            else
+                continue;
+            nfound++;
         }
     }
 
-    MPI_CHECK(MPI_Win_free(&test_config.rdma_win));
+    for (int f = 0; f < nflows; f++)
+    {
+        const struct triage_tests *t = &links[f];
+
+        if (!t->suspect || t->ntests == 0)
+            continue;
+
+        if (triage_bad(t))
+            fprintf(stream, "#   bad link %s -> %s: %.0f MB/s (%+.0f%%)\n",
+                    get_hostname(flows[f].src, true),
+                    get_hostname(flows[f].dst, true), t->bw / t->ntests,
+                    100 * (t->bw / t->ntests - med) / med);
+        else
+            fprintf(stream, "#   not reproduced %s -> %s: %.0f MB/s "
+                            "(%+.0f%%) in the coarse rounds\n",
+                    get_hostname(flows[f].src, true),
+                    get_hostname(flows[f].dst, true), flows[f].bw,
+                    100 * (flows[f].bw - med) / med);
+        nfound++;
+    }
+
+    if (nfound == 0)
+        fprintf(stream, "#   None\n");
+    fprintf(stream, "# Triage done: %d rounds in %.1f s\n", nrounds,
+            MPI_Wtime() - start);
+
+    free(flows);
+    free(links);
+    free(tx);
+    free(rxs);
+    free(values);
+    free(order);
+    free(good);
+    free(tests);
+    free(link_of);
+    free(used);
+}
+
+/* Triage mode: a single size, without the pattern */
+static void test_triage(void)
+{
+    const size_t size = my.sizes[0];
+    struct test_config test_config;
+    int *dst = malloc(sizeof(int) * (my.nclients + 1));
+    float *rx = malloc(sizeof(float) * my.nclients);
+    int client_rank;
 
+    assert(dst && rx);
+    MPI_CHECK(MPI_Comm_rank(clients_comm, &client_rank));
+
+    test_config.pair_bw = NULL;
+    test_config.peers_list = NULL;
+    test_config.nsteps = 1;
+    test_config.step_width = TRIAGE_WIDTH;
+    test_config.verify = alloc_verify_stats();
+    test_config.one_way = alloc_one_way_stats();
+    test_config.data_type = MPI_CHAR;
+    test_config.s_buffer = allocate_buffer(size * my.nflight);
+    test_config.recv_regions = (size_t) my.nflight * TRIAGE_WIDTH;
+    test_config.r_buffer = allocate_buffer(size * test_config.recv_regions);
+    test_config.hist = mallocz(sizeof(struct histogram) * _LINK_LAST);
+    assert(test_config.hist);
+    test_config.scratch = alloc_step_scratch(TRIAGE_WIDTH, my.nflight);
+
+    init_test(TEST_MODE_ALL_TO_ALL, 0, my.niters, my.nflight, size, DIR_NONE,
+              &test_config);
+
+    if (client_rank == MPI_ROOT_RANK)
+        triage_root(&test_config, dst, rx, stdout);
+    else
+        while (triage_round(&test_config, dst, rx))
+            ;
+
+    if (test_config.verify)
+        report_verify(&test_config, stdout);
+
+    msg_type_free(&test_config.data_type);
     destroy_buffer(test_config.s_buffer);
     destroy_buffer(test_config.r_buffer);
+    free(test_config.hist);
+    free_step_scratch(test_config.scratch);
+    free_verify_stats(test_config.verify);
+    free_one_way_stats(test_config.one_way);
+    free(dst);
+    free(rx);
 }
 
-static int alltoall_get_abs_rank(int rel_rank, int step, int size)
+/* Self-calibration: the cost of the harness itself, between two ranks of the
+ * same node whenever possible, to tell what the reported latencies and
+ * message rates owe to the tool rather than to the fabric. Every measurement
+ * runs CALIBRATE_OPS operations CALIBRATE_RUNS times, and the median run is
+ * reported. The window measurements break down the all-to-all step: the raw
+ * messages, then the 1-byte response of every window, then the bookkeeping
+ * of run_test_alltoall_step() (timestamps and histograms) */
+#define CALIBRATE_OPS  1000
+#define CALIBRATE_RUNS 5
+
+/* Smallest non-zero step of MPI_Wtime(), and the cost of a call */
+static void calibrate_timer(float *resolution, float *call)
 {
-    return ((rel_rank - 1 - step + (size - 1)) % (size - 1)) + 1;
+    double step = HUGE_VAL;
+    double start = MPI_Wtime();
+
+    for (int i = 0; i < CALIBRATE_OPS; i++)
+    {
+        const double t0 = MPI_Wtime();
+        double t1;
+
+        while ((t1 = MPI_Wtime()) == t0)
+            ;
+        step = MIN(step, t1 - t0);
+    }
+    *resolution = step;
+
+    start = MPI_Wtime();
+    for (int i = 0; i < CALIBRATE_OPS; i++)
+        (void) MPI_Wtime();
+    *call = (MPI_Wtime() - start) / CALIBRATE_OPS;
 }
 
-/* This function is used the generate a list of remote peers the current rank
- * will be communicating with.
- * This algorithm has been inspired from the 'linktest' tool from FZ Julich:
- * http://www.fz-juelich.de/ias/jsc/EN/Expertise/Support/Software/LinkTest/_node.html
- * It has been modified to be simpler to read and adapted to the need of the
- * network sanitizer.
- */
-static struct peer_entry *
-alltoall_get_peers(int rank, int size)
+/* One MPI_Testsome over the idle slots of a server, as in its polling loop */
+static float calibrate_poll(int nslots)
 {
-    int maxp = (int) (size / 2);
-    int from, to;
+    MPI_Request reqs[nslots];
+    int indices[nslots];
+    char buffer[nslots];
+    double start;
+    int outcount;
 
-    struct peer_entry *peers_list = malloc(sizeof(struct peer_entry) * size);
-    if (peers_list == NULL)
-        return NULL;
+    /* Nobody ever sends to these receives */
+    for (int i = 0; i < nslots; i++)
+        MPI_CHECK(MPI_Irecv(&buffer[i], 1, MPI_CHAR, MPI_ANY_SOURCE,
+                            MPI_ANY_TAG, MPI_COMM_SELF, &reqs[i]));
 
-    for (int step = 0; step < size; step++) {
+    start = MPI_Wtime();
+    for (int i = 0; i < CALIBRATE_OPS; i++)
+        MPI_CHECK(MPI_Testsome(nslots, reqs, &outcount, indices,
+                               MPI_STATUSES_IGNORE));
+    start = MPI_Wtime() - start;
 
-        for (int p = 0; p < (maxp - 1); p++) {
-            from = alltoall_get_abs_rank(maxp - p, step, size);
-            to = alltoall_get_abs_rank(maxp + 1 + p, step, size);
+    for (int i = 0; i < nslots; i++)
+        MPI_CHECK(MPI_Cancel(&reqs[i]));
+    MPI_CHECK(MPI_Waitall(nslots, reqs, MPI_STATUSES_IGNORE));
 
-            if (from == rank)
-            {
-                peers_list[step].rank = to;
-                peers_list[step].role = PEER_RECV;
-            }
-            if (to == rank)
-            {
-                peers_list[step].rank = from;
-                peers_list[step].role = PEER_SEND;
-            }
-        }
+    return start / CALIBRATE_OPS;
+}
 
-        from = 0;
-        to = alltoall_get_abs_rank(1, step, size);
+/* Half of the round trip of a 1-byte ping-pong */
+static float calibrate_loopback(int peer)
+{
+    char byte = 0;
+    double start = MPI_Wtime();
 
-        if (from == rank)
+    for (int i = 0; i < CALIBRATE_OPS; i++)
+    {
+        if (my.glob_rank == 0)
         {
-            peers_list[step].rank = to;
-            peers_list[step].role = PEER_RECV;
+            MPI_CHECK(MPI_Send(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD));
+            MPI_CHECK(MPI_Recv(&byte, 1, MPI_CHAR, peer, 0, MPI_COMM_WORLD,
+                               MPI_STATUS_IGNORE));
         }
-        if (to == rank)
+        else
         {
-            peers_list[step].rank = from;
-            peers_list[step].role = PEER_SEND;
+            MPI_CHECK(MPI_Recv(&byte, 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD,
+                               MPI_STATUS_IGNORE));
+            MPI_CHECK(MPI_Send(&byte, 1, MPI_CHAR, 0, 0, MPI_COMM_WORLD));
         }
     }
-    return peers_list;
+
+    return (MPI_Wtime() - start) / (2 * CALIBRATE_OPS);
 }
 
-#if 0
-static void alltoall_print_peers(struct peer_entry *peers_list, int size)
+/* Windows of nflight 1-byte messages from rank 0 to the peer, optionally
+ * closed by the 1-byte response of run_test_alltoall_step() */
+static float calibrate_window(int peer, bool response)
 {
-    for (int i = 0; i < size; i++)
-        fprintf(stderr, "%d ", peers_list[i].rank);
-    fprintf(stderr, "\n");
+    const int nflight = my.nflight;
+    MPI_Request reqs[nflight + 1];
+    char buffer[nflight + 1];
+    const bool sender = my.glob_rank == 0;
+    double start = MPI_Wtime();
+
+    for (int j = 0; j < CALIBRATE_OPS; j += nflight)
+    {
+        const int k = MIN(nflight, CALIBRATE_OPS - j);
+
+        for (int i = 0; i < k; i++)
+        {
+            if (sender)
+                MPI_CHECK(MPI_Isend(&buffer[i], 1, MPI_CHAR, peer, 0,
+                                    MPI_COMM_WORLD, &reqs[i]));
+            else
+                MPI_CHECK(MPI_Irecv(&buffer[i], 1, MPI_CHAR, 0, 0,
+                                    MPI_COMM_WORLD, &reqs[i]));
+        }
+        if (response && sender)
+            MPI_CHECK(MPI_Irecv(&buffer[k], 1, MPI_CHAR, peer,
+                                ALLTOALL_RESP_TAG, MPI_COMM_WORLD, &reqs[k]));
+        else if (response)
+            MPI_CHECK(MPI_Isend(&buffer[k], 1, MPI_CHAR, 0,
+                                ALLTOALL_RESP_TAG, MPI_COMM_WORLD, &reqs[k]));
+        MPI_CHECK(MPI_Waitall(k + response, reqs, MPI_STATUSES_IGNORE));
+    }
+
+    return (MPI_Wtime() - start) / CALIBRATE_OPS;
 }
-#endif
 
-static double run_test_alltoall_pair(
-        int peer_rank, enum peer_role peer_role,
-        const struct test_config *config)
+/* The same windows through the all-to-all step of the tool */
+static float calibrate_step(int peer, struct test_config *config)
 {
-    double start, end;
-    int k = 0;
+    struct peer_entry peers[1] = {
+        { peer, my.glob_rank == 0 ? PEER_SEND : PEER_RECV },
+    };
 
-    const int niters    = config->niters;
-    const int data_size = config->data_size;
-    const int nflight   = config->nflight;
-    char *s_buffer      = config->s_buffer;
-    char *r_buffer      = config->r_buffer;
+    return run_test_alltoall_step(peers, config) / CALIBRATE_OPS;
+}
 
-    MPI_Request reqs[nflight + 1]; /* +1 for response message */
+/* Empty RPCs: rank 0 keeps nflight 1-byte requests in flight like a client,
+ * the peer answers them with the polling loop of a server, without the RMA
+ * transfer */
+static float calibrate_rpc(int peer)
+{
+    const int nflight = MIN(my.nflight, CALIBRATE_OPS);
+    MPI_Request reqs[nflight * 2];
+    int indices[nflight * 2];
+    MPI_Status statuses[nflight];
+    enum rstate rstates[nflight];
+    char s_buffer[nflight], r_buffer[nflight];
+    int pending[nflight];
+    int posted = 0, completed = 0;
+    double start = MPI_Wtime();
 
-    end = start = MPI_Wtime(); /* Make sure 'end' gets always initialized */
+    if (my.glob_rank != 0)
+        for (int i = 0; i < nflight; i++)
+        {
+            server_post_recv(i, r_buffer, NULL, reqs);
+            rstates[i] = STATE_REQ_POSTED;
+        }
+    else
+        for (int k = 0; k < nflight; k++, posted++)
+        {
+            client_post_rpc(k, peer, s_buffer, r_buffer, NULL, nflight, reqs);
+            pending[k] = 2;
+        }
 
-    for (int j = 0; j < niters; j++)
+    while (completed < CALIBRATE_OPS)
     {
-        if (peer_role == PEER_RECV)
-            MPI_CHECK(MPI_Irecv(&r_buffer[data_size * k], data_size,
-                                MPI_CHAR, peer_rank, 0, MPI_COMM_WORLD,
-                                &reqs[k]));
-        else
+        int outcount;
+
+        if (my.glob_rank == 0)
         {
-            assert(peer_role == PEER_SEND);
-            MPI_CHECK(MPI_Isend(&s_buffer[data_size * k], data_size,
-                                MPI_CHAR, peer_rank, 0, MPI_COMM_WORLD,
-                                &reqs[k]));
+            MPI_CHECK(MPI_Waitsome(nflight * 2, reqs, &outcount, indices,
+                                   MPI_STATUSES_IGNORE));
+            for (int i = 0; i < outcount; i++)
+            {
+                const int slot = indices[i] / 2;
+
+                if (--pending[slot] > 0)
+                    continue;
+                completed++;
+                if (posted++ < CALIBRATE_OPS)
+                {
+                    client_post_rpc(slot, peer, s_buffer, r_buffer, NULL,
+                                    nflight, reqs);
+                    pending[slot] = 2;
+                }
+            }
+            continue;
         }
 
-        /* Nflight reached or last iteration, now send the response and wait
-         * for all reqs (including the response) to complete */
-        if (++k >= nflight || (j == niters - 1))
+        if (my.server_blocking)
+            MPI_CHECK(MPI_Waitsome(nflight, reqs, &outcount, indices,
+                                   statuses));
+        else
+            MPI_CHECK(MPI_Testsome(nflight, reqs, &outcount, indices,
+                                   statuses));
+        for (int j = 0; j < outcount; j++)
         {
-            char response = 'x';
-            const int resp_tag = 42;
+            const int i = indices[j];
 
-            /* Send / Recv response */
-            if (peer_role == PEER_RECV)
+            if (rstates[i] == STATE_REQ_POSTED)
             {
-                response = 'o';
-                MPI_CHECK(MPI_Isend(&response, 1,
-                                    MPI_CHAR, peer_rank,
-                                    resp_tag, MPI_COMM_WORLD,
-                                    &reqs[k]));
+                MPI_CHECK(MPI_Isend(&s_buffer[i], 1, MPI_CHAR,
+                                    statuses[j].MPI_SOURCE,
+                                    statuses[j].MPI_TAG, MPI_COMM_WORLD,
+                                    &reqs[i]));
+                rstates[i] = STATE_RESP_POSTED;
             }
-            else
+            else if (++completed + nflight <= CALIBRATE_OPS)
             {
-                assert(peer_role == PEER_SEND);
-                MPI_CHECK(MPI_Irecv(&response, 1,
-                                    MPI_CHAR, peer_rank,
-                                    resp_tag, MPI_COMM_WORLD,
-                                    &reqs[k]));
+                server_post_recv(i, r_buffer, NULL, reqs);
+                rstates[i] = STATE_REQ_POSTED;
             }
-
-            MPI_CHECK(MPI_Waitall(k + 1, &reqs[0], MPI_STATUSES_IGNORE));
-            assert(response == 'o');
-            end = MPI_Wtime();
-            k = 0;
         }
     }
 
-    return (end - start);
+    return (MPI_Wtime() - start) / CALIBRATE_OPS;
 }
 
-static double run_test_alltoall(const struct test_config *config)
+/* The collectives of a client/server size: 3 barriers before it, and the
+ * SUM/MIN/MAX and histogram reductions of its report */
+static float calibrate_barrier(void)
 {
-    double total_exec_time = 0, step_exec_time = 0;
-    int npeers = my.nclients;
+    double start = MPI_Wtime();
 
-    if (my.output_mode == OUTPUT_VERBOSE)
-        print_header_verbose(config);
+    for (int i = 0; i < CALIBRATE_OPS; i++)
+        MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+
+    return (MPI_Wtime() - start) / CALIBRATE_OPS;
+}
 
-    for (int step = 0; step < npeers - 1; step++)
+/* The reductions of a size, posted like print_results_reduced() does and
+ * completed like flush_results_reduced() */
+static float calibrate_reduce(void)
+{
+    static struct histogram hist, output_hist;
+    struct results_reduced res = { 0 }, output_res;
+    const int nreports = CALIBRATE_OPS / 10;
+    double start = MPI_Wtime();
+
+    for (int i = 0; i < nreports; i++)
     {
-        int peer_rank = config->peers_list[step].rank;
-        enum peer_role peer_role = config->peers_list[step].role;
+        MPI_Request reqs[2];
+
+        MPI_CHECK(MPI_Ireduce(&res, &output_res, 1, reduced_dtype,
+                              reduced_op, MPI_ROOT_RANK, MPI_COMM_WORLD,
+                              &reqs[0]));
+        MPI_CHECK(MPI_Ireduce(&hist, &output_hist, 1, hist_dtype, hist_op,
+                              MPI_ROOT_RANK, MPI_COMM_WORLD, &reqs[1]));
+        MPI_CHECK(MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE));
+    }
 
-        MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+    return (MPI_Wtime() - start) / nreports;
+}
 
-        if (my.sequential_ios)
-        {
-            for (int i = 0; i < npeers; i++)
-            {
-                MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+enum calibrate_metric
+{
+    CALIB_RESOLUTION = 0,
+    CALIB_WTIME,
+    CALIB_POLL,
+    CALIB_LOOPBACK,
+    CALIB_WINDOW,
+    CALIB_RESPONSE,
+    CALIB_STEP,
+    CALIB_RPC,
+    CALIB_BARRIER,
+    CALIB_REDUCE,
+    _CALIB_LAST,
+};
 
-                if (i == peer_rank)
-                    step_exec_time = run_test_alltoall_pair(peer_rank,
-                                                            PEER_SEND, config);
+/* Rank 0 measures against another rank of its node, or rank 1 when it has
+ * none. The other ranks only take part in the collectives */
+static int calibrate_peer(void)
+{
+    for (int rank = 1; rank < my.glob_size; rank++)
+        if (my.node_ids[rank] == my.node_ids[0])
+            return rank;
 
-                if (i == my.glob_rank)
-                    step_exec_time = run_test_alltoall_pair(peer_rank,
-                                                            PEER_RECV, config);
-            }
-        }
-        else
-        {
-            step_exec_time = run_test_alltoall_pair(peer_rank,
-                                                    peer_role, config);
-        }
+    return my.glob_size > 1 ? 1 : MPI_PROC_NULL;
+}
 
-        total_exec_time += step_exec_time;
+/* Both ends start every run of a pair at once */
+static inline void calibrate_sync(int peer)
+{
+    MPI_CHECK(MPI_Sendrecv(NULL, 0, MPI_BYTE, peer, 0, NULL, 0, MPI_BYTE,
+                           peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE));
+}
 
-        if (my.output_mode == OUTPUT_VERBOSE)
-        {
-            struct results res;
-            generate_results(config, 1, step_exec_time, &res);
-            print_results_verbose(config, peer_rank, &res);
-        }
+/* Rank 0 and its peer run the measurements of a pair, 'peer' is the other
+ * end */
+static void calibrate_pair(int peer, float runs[][CALIBRATE_RUNS])
+{
+    struct test_config config;
+
+    config.pair_bw = NULL;
+    config.peers_list = NULL;
+    config.pairs = NULL;
+    config.nsteps = 1;
+    config.step_width = 1;
+    config.recv_regions = my.nflight;
+    config.verify = NULL;
+    config.one_way = NULL;
+    config.data_type = MPI_CHAR;
+    config.s_buffer = allocate_buffer(my.nflight);
+    config.r_buffer = allocate_buffer(my.nflight);
+    config.hist = mallocz(sizeof(struct histogram) * _LINK_LAST);
+    assert(config.hist);
+    config.scratch = alloc_step_scratch(1, my.nflight);
+    init_test(TEST_MODE_ALL_TO_ALL, 0, CALIBRATE_OPS, my.nflight, 1,
+              DIR_NONE, &config);
+
+    for (int r = 0; r < CALIBRATE_RUNS; r++)
+    {
+        calibrate_sync(peer);
+        runs[CALIB_LOOPBACK][r] = calibrate_loopback(peer);
+        calibrate_sync(peer);
+        runs[CALIB_WINDOW][r] = calibrate_window(peer, false);
+        calibrate_sync(peer);
+        runs[CALIB_RESPONSE][r] = calibrate_window(peer, true);
+        calibrate_sync(peer);
+        runs[CALIB_STEP][r] = calibrate_step(peer, &config);
+        calibrate_sync(peer);
+        runs[CALIB_RPC][r] = calibrate_rpc(peer);
     }
 
-    return total_exec_time;
+    msg_type_free(&config.data_type);
+    destroy_buffer(config.s_buffer);
+    destroy_buffer(config.r_buffer);
+    free(config.hist);
+    free_step_scratch(config.scratch);
 }
 
-static void test_alltoall(int start_size, int end_size)
+static void calibrate(FILE *stream)
 {
-    int curr_size;
-    int curr_iter = 0;
-    struct test_config test_config;
-    int npeers = my.nclients - 1;
+    static float runs[_CALIB_LAST][CALIBRATE_RUNS];
+    float us[_CALIB_LAST];
+    const int peer = calibrate_peer();
 
-    /* Allocate buffers */
-    test_config.s_buffer = allocate_buffer(end_size * my.nflight);
-    test_config.r_buffer = allocate_buffer(end_size * my.nflight);
-    test_config.peers_list = alltoall_get_peers(my.glob_rank, my.nclients);
-    assert(test_config.peers_list);
-#if 0
-    alltoall_print_peers(test_config.peers_list, my.nclients);
-#endif
+    for (int r = 0; r < CALIBRATE_RUNS && my.glob_rank == 0; r++)
+    {
+        calibrate_timer(&runs[CALIB_RESOLUTION][r], &runs[CALIB_WTIME][r]);
+        runs[CALIB_POLL][r] = calibrate_poll(my.server_slots);
+    }
 
-    /* Warmup test */
-    init_test(TEST_MODE_ALL_TO_ALL,
-              -1, 2, my.nflight, end_size, DIR_NONE, &test_config);
-    run_test_alltoall(&test_config);
+    if (peer != MPI_PROC_NULL && my.glob_rank == 0)
+        calibrate_pair(peer, runs);
+    else if (peer != MPI_PROC_NULL && my.glob_rank == peer)
+        calibrate_pair(0, runs);
 
-    for (curr_size = start_size; curr_size <= end_size; curr_size *= 2)
+    for (int r = 0; r < CALIBRATE_RUNS; r++)
     {
-        struct results res;
-        double exec_time;
-
-        init_test(TEST_MODE_ALL_TO_ALL,
-                  curr_iter++,
-                  my.niters, my.nflight, curr_size,
-                  DIR_NONE,
-                  &test_config);
+        MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+        runs[CALIB_BARRIER][r] = calibrate_barrier();
+        MPI_CHECK(MPI_Barrier(MPI_COMM_WORLD));
+        runs[CALIB_REDUCE][r] = calibrate_reduce();
+    }
 
-        exec_time = run_test_alltoall(&test_config);
+    if (my.glob_rank != 0)
+        return;
 
-        if (my.output_mode == OUTPUT_MPI)
-        {
-            generate_results(&test_config,
-                             npeers,
-                             exec_time, &res);
-            print_results_reduced(&test_config, &res);
-        }
+    for (int m = 0; m < _CALIB_LAST; m++)
+        us[m] = median(runs[m], CALIBRATE_RUNS) * 1e6;
+
+    fprintf(stream, "# Calibration: median of %d runs of %d operations, "
+                    "%d in flight\n", CALIBRATE_RUNS, CALIBRATE_OPS,
+                    my.nflight);
+    fprintf(stream, "#   timer     %.3f us resolution, %.3f us per call "
+                    "(MPI_Wtick %.3f us)\n", us[CALIB_RESOLUTION],
+                    us[CALIB_WTIME], MPI_Wtick() * 1e6);
+    fprintf(stream, "#   poll      %.3f us per MPI_Testsome of %d idle "
+                    "server slots\n", us[CALIB_POLL], my.server_slots);
+    if (peer != MPI_PROC_NULL)
+    {
+        fprintf(stream, "#   peer      rank %d, %s\n", peer,
+                my.node_ids[peer] == my.node_ids[0] ? "same node" :
+                                                      "other node");
+        fprintf(stream, "#   loopback  %.3f us one way (1 B ping-pong)\n",
+                us[CALIB_LOOPBACK]);
+        fprintf(stream, "#   window    %.3f us per 1 B message\n",
+                us[CALIB_WINDOW]);
+        fprintf(stream, "#   response  %+.3f us per window for its 1-byte "
+                        "response\n",
+                (us[CALIB_RESPONSE] - us[CALIB_WINDOW]) * my.nflight);
+        fprintf(stream, "#   step      %+.3f us per message of bookkeeping "
+                        "in the all-to-all step\n",
+                us[CALIB_STEP] - us[CALIB_RESPONSE]);
+        fprintf(stream, "#   rpc       %.3f us per empty RPC\n",
+                us[CALIB_RPC]);
     }
+    fprintf(stream, "#   barrier   %.3f us per barrier of %d ranks, 3 per "
+                    "client/server size\n", us[CALIB_BARRIER],
+                    my.glob_size);
+    fprintf(stream, "#   reduce    %.3f us per size for the SUM/MIN/MAX and "
+                    "histogram reductions\n", us[CALIB_REDUCE]);
+}
 
-    destroy_buffer(test_config.s_buffer);
-    destroy_buffer(test_config.r_buffer);
-    free(test_config.peers_list);
+/* Find out which ranks share the same node: the ranks of a shared memory
+ * communicator get the node index of its first rank */
+static void discover_locality(void)
+{
+    MPI_Comm node_comm;
+    int node_rank, leader, node_id = 0;
+
+    my.node_ids = malloc(sizeof(int) * my.glob_size);
+    assert(my.node_ids);
+
+    MPI_CHECK(MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED,
+                                  my.glob_rank, MPI_INFO_NULL, &node_comm));
+    MPI_CHECK(MPI_Comm_rank(node_comm, &node_rank));
+
+    /* Number the nodes from their leader, i.e. rank 0 of node_comm */
+    leader = node_rank == 0;
+    MPI_CHECK(MPI_Exscan(&leader, &node_id, 1, MPI_INT, MPI_SUM,
+                         MPI_COMM_WORLD));
+    if (my.glob_rank == 0)
+        node_id = 0; /* Exscan leaves it undefined */
+    MPI_CHECK(MPI_Bcast(&node_id, 1, MPI_INT, 0, node_comm));
+    MPI_CHECK(MPI_Allreduce(&leader, &my.nnodes, 1, MPI_INT, MPI_SUM,
+                            MPI_COMM_WORLD));
+    MPI_CHECK(MPI_Comm_free(&node_comm));
+
+    my.node_ids[my.glob_rank] = node_id;
+    MPI_CHECK(MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
+                            my.node_ids, 1, MPI_INT, MPI_COMM_WORLD));
 }
 
+/* Only the leader of every node, its lowest rank, sends the name of the node,
+ * with its own length: the ranks know the node of every other rank from
+ * discover_locality(), and the nodes are numbered in the order of their
+ * leaders, which is the order of the names gathered */
 void exchange_hostnames(void)
 {
-    my.hosts = mallocz(my.glob_size * HOST_MAX_SIZE);
-    assert(my.hosts);
-
-    gethostname(my.hostname, HOST_MAX_SIZE);
-    my.hostname[HOST_MAX_SIZE - 1] = '\0';
+    char hostname[HOST_NAME_MAX + 1];
+    int *lengths, *displs, length = 0, node = 0;
+    size_t hosts_size = 0;
+    char *names, *host;
+    bool leader = true;
 
-    int local_rank;
+    gethostname(hostname, sizeof(hostname));
+    hostname[sizeof(hostname) - 1] = '\0';
 
-    if (is_server())
-        local_rank = my.glob_rank;
-    else
-        MPI_CHECK(MPI_Comm_rank(clients_comm, &local_rank));
+    for (int rank = 0; rank < my.glob_rank && leader; rank++)
+        leader = my.node_ids[rank] != my.node_ids[my.glob_rank];
+    if (leader)
+        length = strlen(hostname) + 1;
 
-    /* Append the global rank  */
-    snprintf(my.hostname + strnlen(my.hostname, HOST_MAX_SIZE),
-             HOST_MAX_SIZE,
-             "-%d",
-             local_rank);
+    lengths = malloc(sizeof(int) * my.glob_size);
+    displs = malloc(sizeof(int) * my.glob_size);
+    assert(lengths && displs);
 
-    MPI_CHECK(MPI_Allgather(my.hostname,
-                            HOST_MAX_SIZE, MPI_BYTE,
-                            my.hosts, HOST_MAX_SIZE, MPI_BYTE,
+    MPI_CHECK(MPI_Allgather(&length, 1, MPI_INT, lengths, 1, MPI_INT,
                             MPI_COMM_WORLD));
-    memcpy(my.hosts + (my.glob_rank * HOST_MAX_SIZE), my.hostname,
-           HOST_MAX_SIZE);
+    for (int rank = 0; rank < my.glob_size; rank++)
+        displs[rank] = rank ? displs[rank - 1] + lengths[rank - 1] : 0;
+
+    names = malloc(displs[my.glob_size - 1] + lengths[my.glob_size - 1]);
+    assert(names);
+    MPI_CHECK(MPI_Allgatherv(hostname, length, MPI_CHAR,
+                             names, lengths, displs, MPI_CHAR,
+                             MPI_COMM_WORLD));
+
+    my.nodes = malloc(sizeof(char *) * my.nnodes);
+    assert(my.nodes);
+    for (int rank = 0; rank < my.glob_size; rank++)
+        if (lengths[rank] > 0)
+            my.nodes[node++] = names + displs[rank];
+    assert(node == my.nnodes);
+
+    /* Suffix the name of the node with the rank of the server, or the rank
+     * of the client in clients_comm */
+    for (int rank = 0; rank < my.glob_size; rank++)
+        hosts_size += snprintf(NULL, 0, "%s-%d", my.nodes[my.node_ids[rank]],
+                               rank - (rank < my.nservers ? 0 : my.nservers))
+                      + 1;
+
+    my.hosts = malloc(sizeof(char *) * my.glob_size);
+    host = malloc(hosts_size);
+    assert(my.hosts && host);
+    for (int rank = 0; rank < my.glob_size; rank++)
+    {
+        my.hosts[rank] = host;
+        host += sprintf(host, "%s-%d", my.nodes[my.node_ids[rank]],
+                        rank - (rank < my.nservers ? 0 : my.nservers)) + 1;
+    }
+
+    free(lengths);
+    free(displs);
+}
+
+/* One key of the configuration record: a JSON member, or 'key=value' on the
+ * '#' line of CSV */
+static void results_config(FILE *stream, const char *key, bool string,
+                           const char *fmt, ...)
+{
+    const bool json = my.results_format == RESULTS_FORMAT_JSON;
+    va_list ap;
+
+    fprintf(stream, json ? ",\"%s\":%s" : " %s=%s", key,
+            json && string ? "\"" : "");
+    va_start(ap, fmt);
+    vfprintf(stream, fmt, ap);
+    va_end(ap);
+    if (json && string)
+        fputc('"', stream);
+}
+
+/* Load the baseline and start the results file on the root of the clients,
+ * with the configuration and the hosts. Returns false on all the ranks if
+ * either one can not be opened */
+static bool results_open(void)
+{
+    const bool json = my.results_format == RESULTS_FORMAT_JSON;
+    FILE *stream = NULL;
+    char start[32];
+    int ok = 1;
+
+    if (my.glob_rank == my.nservers && my.baseline_path &&
+        !load_baseline(my.baseline_path))
+    {
+        fprintf(stderr, "Cannot read the baseline %s\n", my.baseline_path);
+        ok = 0;
+    }
+    if (my.glob_rank == my.nservers && ok && my.results_path)
+    {
+        stream = fopen(my.results_path, "w");
+        if (stream == NULL)
+        {
+            fprintf(stderr, "Cannot open %s\n", my.results_path);
+            ok = 0;
+        }
+    }
+    MPI_CHECK(MPI_Bcast(&ok, 1, MPI_INT, my.nservers, MPI_COMM_WORLD));
+    if (stream == NULL)
+        return ok;
+    results_state.stream = stream;
+
+    format_utc(time(NULL), start, sizeof(start));
+    fprintf(stream, json ? "{\"type\":\"config\"" : "# config");
+    results_config(stream, "start", true, "%s", start);
+    results_config(stream, "mode", true, "%s",
+                   my.nservers > 0 ? "client-server" : "all-to-all");
+    results_config(stream, "nservers", false, "%d", my.nservers);
+    results_config(stream, "nclients", false, "%d", my.nclients);
+    results_config(stream, "nnodes", false, "%d", my.nnodes);
+    results_config(stream, "niters", false, "%d", my.niters);
+    results_config(stream, "nflight", false, "%d", my.nflight);
+    results_config(stream, "intra_node", true, "%s",
+                   intra_mode_str[my.intra_mode]);
+    results_config(stream, "sequential", false, "%d", my.sequential_ios);
+    results_config(stream, "concurrent", false, "%d", my.concurrent);
+    results_config(stream, "bidirectional", false, "%d", my.bidirectional);
+    results_config(stream, "persistent", false, "%d", my.persistent);
+    results_config(stream, "rma", false, "%d", my.alltoall_rma);
+    results_config(stream, "pattern", true, "%s", pattern_str[my.pattern]);
+    results_config(stream, "seed", false, "%u", my.seed);
+    results_config(stream, "fanout", false, "%d", my.fanout);
+    results_config(stream, "buffers", true, "%s",
+                   buffer_kind_str[my.buffer_kind]);
+    results_config(stream, "verify", false, "%d", my.verify);
+    results_config(stream, "time_per_size_s", false, "%g",
+                   my.time_per_size);
+    results_config(stream, "nsizes", false, "%d", my.nsizes);
+    fputs(json ? "}\n" : "\n", stream);
+
+    for (int rank = 0; rank < my.glob_size; rank++)
+    {
+        fprintf(stream, json ? "{\"type\":\"host\"" : "# host");
+        results_config(stream, "rank", false, "%d", rank);
+        results_config(stream, "name", true, "%s",
+                       get_hostname(rank, false));
+        results_config(stream, "node", false, "%d", my.node_ids[rank]);
+        fputs(json ? "}\n" : "\n", stream);
+    }
+
+    for (size_t f = 0; f < RECORD_NFIELDS && !json; f++)
+        fprintf(stream, "%s%s", f ? "," : "", record_fields[f].name);
+    if (!json)
+        fputc('\n', stream);
+    return ok;
+}
+
+/* Close the results file, and report the regressions against the
+ * baseline */
+static void results_close(FILE *stream)
+{
+    size_t nmissing = 0;
+
+    if (results_state.stream)
+    {
+        fclose(results_state.stream);
+        results_state.stream = NULL;
+    }
+    if (results_state.baseline == NULL)
+        return;
+
+    for (size_t i = 0; i < results_state.nbaseline; i++)
+        nmissing += !results_state.matched[i];
+
+    fclose(results_state.regressions);
+    fprintf(stream, "# Baseline %s: %d records compared, %d regressions "
+                    "beyond %g%%, %zu records of the baseline not run\n",
+            my.baseline_path, results_state.ncompared,
+            results_state.nregressions, my.tolerance, nmissing);
+    fputs(results_state.nregressions ? results_state.regressions_text :
+                                       "#   None\n", stream);
+
+    /* A gate which compared nothing, or only part of the baseline, would
+     * pass a run which did not measure what the baseline did */
+    results_state.incomplete = results_state.ncompared == 0 || nmissing > 0;
+    if (results_state.incomplete)
+        fprintf(stream, "#   Incomplete: the run has to cover every record "
+                        "of the baseline\n");
+
+    free(results_state.regressions_text);
+    free(results_state.baseline);
+    free(results_state.matched);
+    results_state.baseline = NULL;
 }
 
 int main(int argc, char *argv[])
 {
-    int start_size = 1;
-    int end_size = (1 << 22);
+    bool fits = true;
 
     parse_args(argc, argv);
 
+    if (my.expand || my.expand_file)
+        return expand_hosts(stdout);
+
+    /* Default sweep: powers of two from 1 B to 4 MiB, monitoring runs the
+     * largest one */
+    if (my.nsizes == 0)
+        parse_sizes(my.monitor > 0 || my.triage > 0 ? "4M" : "1:4M:x2");
+
+    if (my.monitor > 0 &&
+        (my.nsizes > 1 || my.time_per_size > 0 || my.duration > 0 ||
+         my.matrix_prefix || my.analyze || my.alltoall_rma))
+    {
+        fprintf(stderr, "--monitor runs a single size, without --matrix, "
+                        "--analyze, --rma or a time budget\n");
+        return EXIT_FAILURE;
+    }
+
+    if (my.triage > 0 &&
+        (my.nsizes > 1 || my.time_per_size > 0 || my.duration > 0 ||
+         my.matrix_prefix || my.analyze || my.alltoall_rma ||
+         my.monitor > 0 || my.sequential_ios || my.bidirectional ||
+         my.pattern != PATTERN_LINKTEST || my.fanout != 1 ||
+         my.intra_mode != INTRA_INCLUDE))
+    {
+        fprintf(stderr, "--triage runs a single size of its own one-way "
+                        "rounds, without --matrix, --analyze, --rma, "
+                        "--monitor, --sequential, --bidirectional, "
+                        "--pattern, --fanout, --intra-node or a time "
+                        "budget\n");
+        return EXIT_FAILURE;
+    }
+
     init_mpi(argc, argv, my.nservers);
     my.nclients = (my.glob_size - my.nservers);
 
-    /* Exchange hostnames if requested */
-    if (my.hostname_resolve)
+    discover_locality();
+
+    if (strcmp(my.numa, "auto") == 0)
+    {
+        my.numa_node = hca_numa_node();
+        if (my.numa_node < 0 && my.glob_rank == MPI_ROOT_RANK)
+            fprintf(stderr, "NUMA node of the HCA unknown, buffers are "
+                            "not bound\n");
+    }
+    else if (strcmp(my.numa, "none") != 0)
+        my.numa_node = atoi(my.numa);
+
+    /* Exchange hostnames if requested, the matrix and its analysis always
+     * need them */
+    if (my.hostname_resolve || my.matrix_prefix || my.analyze || my.verify ||
+        my.series_path || my.clock_sync || my.pairs || my.triage > 0 ||
+        results_enabled())
         exchange_hostnames();
 
-    if (my.bsize >= 0)
-        start_size = end_size = my.bsize;
+    if (my.verify)
+        crc32c_init();
 
-    if (my.glob_rank == 0)
-        fprintf(stdout, "#nservers=%i nclients=%d niters=%d nflight=%d "
-                        "sequential=%d ssize=%d, esize=%d\n",
-                        my.nservers, my.nclients, my.niters, my.nflight,
-                        my.sequential_ios, start_size, end_size);
+    /* Split the duration evenly between the sizes, and the sweeps run for
+     * every size: PUT and GET in client/server mode, the two-sided one then
+     * the Put and Get ones of --rma in all-to-all mode */
+    if (my.duration > 0)
+        my.time_per_size = my.duration /
+                           (my.nsizes * (my.nservers > 0 ? 2 :
+                                         my.alltoall_rma ? 3 : 1));
 
-    if (my.nservers <= 0)
+    if (my.glob_rank == 0)
+        fprintf(stdout, "#nservers=%i nclients=%d nnodes=%d niters=%d "
+                        "nflight=%d intra-node=%s "
+                        "sequential=%d concurrent=%d bidirectional=%d "
+                        "persistent=%d pattern=%s fanout=%d buffers=%s "
+                        "numa=%d verify=%d monitor=%g interval=%g "
+                        "clock-sync=%d triage=%g "
+                        "time-per-size=%g nsizes=%d ssize=%zu, esize=%zu\n",
+                        my.nservers, my.nclients, my.nnodes, my.niters,
+                        my.nflight, intra_mode_str[my.intra_mode],
+                        my.sequential_ios, my.concurrent, my.bidirectional,
+                        my.persistent, pattern_str[my.pattern], my.fanout,
+                        buffer_kind_str[my.buffer_kind], my.numa_node,
+                        my.verify, my.monitor, my.interval, my.clock_sync,
+                        my.triage,
+                        my.time_per_size, my.nsizes, my.sizes[0],
+                        my.sizes[my.nsizes - 1]);
+
+    if (my.clock_sync)
+        init_clock();
+
+    if (results_enabled() && !results_open())
+        return EXIT_FAILURE;
+
+    if (my.calibrate)
+        calibrate(stdout);
+
+    if (my.nservers <= 0 && my.triage > 0)
     {
-        if (my.nclients % 2)
+        if (my.nclients < 2)
+        {
+            fprintf(stderr, "--triage requires at least 2 clients\n");
+            return EXIT_FAILURE;
+        }
+        test_triage();
+    }
+    else if (my.nservers <= 0)
+    {
+        if (my.pairs)
+        {
+            fprintf(stderr, "--pairs is only available in client/server "
+                            "mode, see --matrix for all-to-all mode\n");
+            return EXIT_FAILURE;
+        }
+        if (pattern_needs_even(my.pattern) && my.nclients % 2)
         {
             fprintf(stderr,
-                    "Alltoall mode requires an even number of clients\n");
+                    "Alltoall mode requires an even number of clients "
+                    "with the %s pattern\n", pattern_str[my.pattern]);
             return EXIT_FAILURE;
         }
-        test_alltoall(start_size, end_size);
+        fits = test_alltoall();
     }
     else
     {
-        test_client_server(start_size, end_size, DIR_PUT);
-        test_client_server(start_size, end_size, DIR_GET);
+        if (my.matrix_prefix)
+        {
+            fprintf(stderr, "The link-bandwidth matrix is only available "
+                            "in all-to-all mode\n");
+            return EXIT_FAILURE;
+        }
+        if (my.monitor > 0)
+        {
+            fprintf(stderr, "--monitor is only available in all-to-all "
+                            "mode\n");
+            return EXIT_FAILURE;
+        }
+        if (my.triage > 0)
+        {
+            fprintf(stderr, "--triage is only available in all-to-all "
+                            "mode\n");
+            return EXIT_FAILURE;
+        }
+        if (my.alltoall_rma)
+        {
+            fprintf(stderr, "--rma only applies to all-to-all mode, "
+                            "client/server mode is always one-sided\n");
+            return EXIT_FAILURE;
+        }
+        test_client_server(DIR_PUT);
+        test_client_server(DIR_GET);
     }
 
+    if (my.verify && my.glob_rank == my.nservers)
+        fprintf(stdout, "# Integrity: %"PRIu64" corrupted messages out of "
+                        "%"PRIu64" checked\n", my.corrupted, my.verified);
+
+    if (results_enabled() && my.glob_rank == my.nservers)
+        results_close(stdout);
+
     destroy_mpi();
 
+    /* The names of the nodes and of the ranks are each in one block,
+     * starting with rank 0 */
     if (my.hosts)
     {
+        free(my.nodes[0]);
+        free(my.nodes);
+        my.nodes = NULL;
+        free(my.hosts[0]);
         free(my.hosts);
         my.hosts = NULL;
     }
 
-    return EXIT_SUCCESS;
+    free(my.node_ids);
+    my.node_ids = NULL;
+    free(my.sizes);
+    my.sizes = NULL;
+
+    /* Silent corruption is a failure, whatever the performance, and so is
+     * a regression against the baseline or a run which does not cover it */
+    return !fits || my.corrupted || results_state.nregressions ||
+           results_state.incomplete ? EXIT_FAILURE : EXIT_SUCCESS;
 }
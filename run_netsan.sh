@@ -35,8 +35,10 @@ MPIEXEC="mpiexec"
 NETSAN="./net_sanitizer"
 
 SERVERS_LIST=""
+SERVERS_FILE=""
 NUM_SERVERS=""
-CLIENTS=""
+CLIENTS_LIST=""
+CLIENTS_FILE=""
 NUM_CLIENTS=""
 CLIENTS_NRANKS="1"
 SERVERS_NRANKS="1"
@@ -47,35 +49,85 @@ CLIENTS_ARGS=""
 . "$SC_DIR/common.sh"
 
 
-not_implemented()
+# Expand the hostlist and the host file of the servers or the clients with
+# net_sanitizer itself, then give every host its number of ranks for -hosts
+expand_hosts()
 {
-    echo "Not implemented yet!"
-    exit 1;
+    local list=$1
+    local file=$2
+    local nranks=$3
+    local args=()
+    local hosts
+
+    [[ -n "$list" ]] && args+=(--expand "$list")
+    [[ -n "$file" ]] && args+=(--expand-file "$file")
+    [[ ${#args[@]} -eq 0 ]] && return 0
+
+    hosts=$("$NETSAN" "${args[@]}") || return 1
+    printf "%s" "${hosts//,/:$nranks,}:$nranks"
 }
 
 usage()
 {
     echo "${SC_NAME}"
     echo "    --servers <list>              List of servers."
-    echo "    --servers-file <file>         File containing the server names (not implemented)."
+    echo "    --servers-file <file>         File containing the server names, one hostlist per line."
     echo "    --servers-nranks <num>        Number of MPI ranks per server."
     echo "    --servers-args <args>         Extra mpirun args for servers."
     echo "    --clients <list>              List of clients."
-    echo "    --clients-file <file>         File containing the client names (not implemented)."
+    echo "    --clients-file <file>         File containing the client names, one hostlist per line."
     echo "    --clients-nranks <num>        Number of MPI ranks per client."
     echo "    --clients-args <args>         Extra mpirun args for clients."
     echo "    --niters <num>                Number of iterations."
     echo "    --nflight <num>               Number of infligh messages."
-    echo "    --bsize <num>                 Buffer size (in bytes)."
+    echo "    --bsize <num>                 Buffer size (in bytes, K/M/G suffixes allowed)."
+    echo "    --sizes <spec>                Sizes to test: <start>:<end>[:x<mult>], <start>:<end>:+<step> or <size>,<size>,..."
     echo "    --verbose                     Enable verbose mode."
     echo "    --hostnames                   Use hostname resolution for MPI ranks."
     echo "    --sequential                  Use sequential mode, where only one pair of MPI ranks communicate at any time."
+    echo "    --concurrent <num>            Number of pairs communicating at once in sequential mode (default: 1)."
+    echo "    --bidirectional               Both peers of each pair send and receive at once (all-to-all)."
+    echo "    --pattern <name>              All-to-all pattern: linktest (default), shift, random, bisection, incast, broadcast or neighbor."
+    echo "    --seed <num>                  Seed of the random pattern."
+    echo "    --fanout <num>                Number of rounds of the all-to-all pattern run at once."
+    echo "    --intra-node <mode>           Links between ranks of the same node: include (default), skip or separate."
+    echo "    --matrix <prefix>             Write the all-to-all link-bandwidth matrix to <prefix>.bin."
+    echo "    --matrix-export <fmt>         Also export the matrix to <prefix>.csv or <prefix>.json: none (default), csv or json."
+    echo "    --analyze                     Look for slow ranks and links (all-to-all), or slow servers, clients and pairs (client/server)."
+    echo "    --time-per-size <sec>         Run each size for about <sec> seconds instead of --niters iterations."
+    echo "    --duration <sec>              Run the whole sweep in about <sec> seconds."
+    echo "    --ci <percent>                With a time budget, stop a size once its bandwidth is known within <percent> (default: 1)."
+    echo "    --persistent                  Use persistent MPI requests in the test loops."
+    echo "    --rma                         Also run each all-to-all size with one-sided Put and Get."
+    echo "    --buffers <kind>              Memory of the data buffers: malloc (default), huge2m, huge1g or mpi."
+    echo "    --numa <node>                 Bind the data buffers to a NUMA node: none (default), auto (node of the HCA) or <node>."
+    echo "    --verify                      Check the payload of every message and report the corrupted ones per link."
+    echo "    --monitor <sec>               Repeat the all-to-all pattern with a single size for <sec> seconds."
+    echo "    --interval <sec>              Seconds between two monitoring reports (default: 60)."
+    echo "    --series <file>               Write the per-link time series of the monitoring to a CSV file."
+    echo "    --clock-sync                  Synchronize the clocks to report one-way latencies, start/finish spread and asymmetric links."
+    echo "    --pairs                       Report the RPCs of every (client, server) pair in client/server mode."
+    echo "    --triage <percent>            Localize the bad ranks and links in a few rounds; flows below <percent> of the median are slow."
+    echo "    --calibrate                   Measure the overheads of the tool before the results."
+    echo "    --results <file>              Write the configuration, hosts, sizes, pairs and nodes to a file, one record per line."
+    echo "    --results-format <format>     Format of the results file: json (JSON lines, default) or csv."
+    echo "    --baseline <file>             Compare the results with a previous results file, and fail on regressions"
+    echo "                                  or when the run does not cover every record of the baseline."
+    echo "    --tolerance <percent>         Bandwidth or latency regression allowed by --baseline (default: 10)."
+    echo "    --batch                       Wait for the whole nflight window to drain before posting new RPCs (client/server)."
+    echo "    --server-slots <num>          Number of RPCs a server processes in parallel (default: 128)."
+    echo "    --server-blocking             Block instead of polling for RPC completions on servers."
     echo "    --help                        Print this help message."
 }
 
 OPTS="$(getopt -o h,v -l servers:,servers-file:,niters:,\
-clients:,clients-file:,bsize:,help,nflight:,verbose,hostnames,\
-clients-nranks:,servers-nranks:,clients-args:,servers-args:,sequential -n "$0" -- "$@")"
+clients:,clients-file:,bsize:,sizes:,help,nflight:,verbose,hostnames,\
+clients-nranks:,servers-nranks:,clients-args:,servers-args:,sequential,\
+batch,server-slots:,server-blocking,bidirectional,\
+pattern:,seed:,fanout:,intra-node:,matrix:,matrix-export:,analyze,\
+time-per-size:,duration:,ci:,persistent,rma,buffers:,numa:,verify,monitor:,interval:,series:,\
+clock-sync,pairs,concurrent:,triage:,calibrate,\
+results:,results-format:,baseline:,tolerance: -n "$0" -- "$@")"
 eval set -- "$OPTS"
 
 while true
@@ -89,7 +141,7 @@ do
             shift 2
             ;;
         --servers-file)
-            not_implemented
+            SERVERS_FILE="$2"
             shift 2
             ;;
         --servers-nranks)
@@ -105,7 +157,7 @@ do
             shift 2
             ;;
         --clients-file)
-            not_implemented
+            CLIENTS_FILE="$2"
             shift 2
             ;;
         --clients-nranks)
@@ -128,6 +180,130 @@ do
            NETSAN_OPTS+=" --sequential "
            shift
            ;;
+        --concurrent)
+           NETSAN_OPTS+=" --concurrent $2"
+           shift 2
+           ;;
+        --bidirectional)
+           NETSAN_OPTS+=" --bidirectional "
+           shift
+           ;;
+        --pattern)
+           NETSAN_OPTS+=" --pattern $2"
+           shift 2
+           ;;
+        --seed)
+           NETSAN_OPTS+=" --seed $2"
+           shift 2
+           ;;
+        --fanout)
+           NETSAN_OPTS+=" --fanout $2"
+           shift 2
+           ;;
+        --intra-node)
+           NETSAN_OPTS+=" --intra-node $2"
+           shift 2
+           ;;
+        --matrix)
+           NETSAN_OPTS+=" --matrix $2"
+           shift 2
+           ;;
+        --matrix-export)
+           NETSAN_OPTS+=" --matrix-export $2"
+           shift 2
+           ;;
+        --analyze)
+           NETSAN_OPTS+=" --analyze "
+           shift
+           ;;
+        --time-per-size)
+           NETSAN_OPTS+=" --time-per-size $2"
+           shift 2
+           ;;
+        --duration)
+           NETSAN_OPTS+=" --duration $2"
+           shift 2
+           ;;
+        --ci)
+           NETSAN_OPTS+=" --ci $2"
+           shift 2
+           ;;
+        --persistent)
+           NETSAN_OPTS+=" --persistent "
+           shift
+           ;;
+        --rma)
+           NETSAN_OPTS+=" --rma "
+           shift
+           ;;
+        --buffers)
+           NETSAN_OPTS+=" --buffers $2"
+           shift 2
+           ;;
+        --numa)
+           NETSAN_OPTS+=" --numa $2"
+           shift 2
+           ;;
+        --verify)
+           NETSAN_OPTS+=" --verify "
+           shift
+           ;;
+        --monitor)
+           NETSAN_OPTS+=" --monitor $2"
+           shift 2
+           ;;
+        --interval)
+           NETSAN_OPTS+=" --interval $2"
+           shift 2
+           ;;
+        --series)
+           NETSAN_OPTS+=" --series $2"
+           shift 2
+           ;;
+        --clock-sync)
+           NETSAN_OPTS+=" --clock-sync "
+           shift
+           ;;
+        --pairs)
+           NETSAN_OPTS+=" --pairs "
+           shift
+           ;;
+        --triage)
+           NETSAN_OPTS+=" --triage $2"
+           shift 2
+           ;;
+        --calibrate)
+           NETSAN_OPTS+=" --calibrate "
+           shift
+           ;;
+        --results)
+           NETSAN_OPTS+=" --results $2"
+           shift 2
+           ;;
+        --results-format)
+           NETSAN_OPTS+=" --results-format $2"
+           shift 2
+           ;;
+        --baseline)
+           NETSAN_OPTS+=" --baseline $2"
+           shift 2
+           ;;
+        --tolerance)
+           NETSAN_OPTS+=" --tolerance $2"
+           shift 2
+           ;;
+        --batch)
+           NETSAN_OPTS+=" --batch "
+           shift
+           ;;
+        --server-slots)
+           NETSAN_OPTS+=" --server-slots $2"
+           shift 2
+           ;;
+        --server-blocking)
+           NETSAN_OPTS+=" --server-blocking "
+           shift
+           ;;
         --nflight)
            NETSAN_OPTS+=" --nflight $2"
            shift 2
@@ -136,6 +312,10 @@ do
            NETSAN_OPTS+=" --bsize $2"
            shift 2
            ;;
+        --sizes)
+           NETSAN_OPTS+=" --sizes $2"
+           shift 2
+           ;;
         -v|--verbose)
            NETSAN_OPTS+=" --verbose"
            shift
@@ -147,10 +327,12 @@ do
     esac
 done
 
-SERVERS_LIST=$(node_set "$SERVERS_LIST" ":$SERVERS_NRANKS")
+SERVERS_LIST=$(expand_hosts "$SERVERS_LIST" "$SERVERS_FILE" \
+                            "$SERVERS_NRANKS") || exit 1
 NUM_SERVERS=$(($(echo $SERVERS_LIST | awk -F, '{print NF}')  * $SERVERS_NRANKS))
 
-CLIENTS_LIST=$(node_set "$CLIENTS_LIST" ":$CLIENTS_NRANKS")
+CLIENTS_LIST=$(expand_hosts "$CLIENTS_LIST" "$CLIENTS_FILE" \
+                            "$CLIENTS_NRANKS") || exit 1
 NUM_CLIENTS=$(($(echo $CLIENTS_LIST | awk -F, '{print NF}') * $CLIENTS_NRANKS))
 
 COMMON_OPTS="-hosts $SERVERS_LIST,$CLIENTS_LIST"